@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Merges result files (lines of "score,tricks,winner,deck[,start]" as written to
+// high_score.txt) from many runs and machines into a single ranked archive,
+// without holding more than a fixed memory budget of records at a time.
+//
+// Pass 1 radix-sorts chunks of records by deal in parallel and writes them as
+// sorted runs. Pass 2 k-way merges the runs, drops duplicate games, and produces
+// runs ranked by score. Pass 3 merges those into the output file. When there are
+// more runs than the fan-in, groups of them are first merged into longer runs so
+// that no merge has more than that many files open.
+
+// Card representation: 0=non-face card, 1=J, 2=Q, 3=K, 4=A
+struct deck {
+    static constexpr int size = 52;
+    std::vector<int> cards;
+
+    deck() : cards(size, 0) {}
+
+    // Check if the deck has exactly 4 of each face card
+    bool is_valid() const {
+        int counts[5] = {0}; // Index 0 for non-face cards, 1-4 for J,Q,K,A
+        for (int card : cards) {
+            if (card < 0 || card > 4) return false;
+            counts[card]++;
+        }
+        for (int i = 1; i <= 4; ++i) {
+            if (counts[i] != 4) return false;
+        }
+        return true;
+    }
+
+    // Create a deck from a string representation
+    static deck from_string(const std::string& str) {
+        deck d;
+        for (size_t i = 0; i < std::min(str.size(), d.cards.size()); ++i) {
+            switch (str[i]) {
+                case 'J': d.cards[i] = 1; break;
+                case 'Q': d.cards[i] = 2; break;
+                case 'K': d.cards[i] = 3; break;
+                case 'A': d.cards[i] = 4; break;
+                default: d.cards[i] = 0;
+            }
+        }
+        return d;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const deck& d) {
+        for (auto i : d.cards) {
+            char c;
+            switch (i) {
+                case 1: c = 'J'; break;
+                case 2: c = 'Q'; break;
+                case 3: c = 'K'; break;
+                case 4: c = 'A'; break;
+                default: c = '-';
+            }
+            os << c;
+        }
+        return os;
+    }
+};
+
+// Compact 128-bit key of a deal, same layout as in main-imp.cpp
+struct DeckKey {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    static DeckKey from_deck(const deck& d) {
+        DeckKey k;
+        int faces = 0;
+        for (int i = 0; i < deck::size; ++i) {
+            int card = d.cards[i];
+            if (card > 0) {
+                // `lo` has room for the 16 face cards of a deal and no more
+                if (faces == 16) throw std::invalid_argument("deck has more than 16 face cards");
+                k.hi |= uint64_t(1) << (63 - i);
+                k.lo |= uint64_t(card - 1) << (62 - 2 * faces++);
+            }
+        }
+        return k;
+    }
+
+    deck to_deck() const {
+        deck d;
+        uint64_t mask = hi;
+        for (int faces = 0; mask != 0; ++faces) {
+            int pos = __builtin_clzll(mask);
+            mask &= ~(uint64_t(1) << (63 - pos));
+            d.cards[pos] = int((lo >> (62 - 2 * faces)) & 3) + 1;
+        }
+        return d;
+    }
+
+    // Byte `i` of the key in sort order, for radix sorts (0 <= i < 16)
+    uint8_t byte(int i) const {
+        return i < 8 ? uint8_t(hi >> (56 - 8 * i)) : uint8_t(lo >> (120 - 8 * i));
+    }
+
+    bool operator==(const DeckKey& o) const { return hi == o.hi && lo == o.lo; }
+    bool operator<(const DeckKey& o) const { return hi != o.hi ? hi < o.hi : lo < o.lo; }
+
+    friend std::ostream& operator<<(std::ostream& os, const DeckKey& k) {
+        return os << k.to_deck();
+    }
+};
+
+// One archived game. A game is identified by its deal and the starting player.
+struct record {
+    DeckKey key;
+    uint32_t score;
+    uint16_t tricks;
+    uint8_t winner;
+    uint8_t start;
+
+    bool same_game(const record& o) const { return key == o.key && start == o.start; }
+
+    static bool by_game(const record& a, const record& b) {
+        return a.key == b.key ? a.start < b.start : a.key < b.key;
+    }
+
+    static bool by_rank(const record& a, const record& b) {
+        return a.score != b.score ? a.score > b.score : by_game(a, b);
+    }
+
+    // Sort digits for the dedup pass: 16 key bytes, then the start player
+    uint8_t digit(int i) const { return i < 16 ? key.byte(i) : start; }
+};
+
+bool parse_record(const std::string& line, record& r) {
+    std::istringstream is(line);
+    std::string score, tricks, winner, cards, start;
+    if (!std::getline(is, score, ',') || !std::getline(is, tricks, ',') ||
+        !std::getline(is, winner, ',') || !std::getline(is, cards, ',')) {
+        return false;
+    }
+    std::getline(is, start, ',');
+    if (cards.size() != size_t(deck::size) || cards.find_first_not_of("-JQKA") != std::string::npos) return false;
+    deck d = deck::from_string(cards);
+    if (!d.is_valid()) return false;
+    try {
+        r.score = uint32_t(std::stoul(score));
+        r.tricks = uint16_t(std::stoul(tricks));
+        r.winner = uint8_t(std::stoi(winner));
+        r.start = uint8_t(start.empty() ? 1 : std::stoi(start));
+    } catch (const std::exception&) {
+        return false;
+    }
+    r.key = DeckKey::from_deck(d);
+    return true;
+}
+
+void write_record(std::ostream& os, const record& r) {
+    os << r.score << "," << r.tricks << "," << int(r.winner) << "," << r.key;
+    if (r.start != 1) os << "," << int(r.start);
+    os << "\n";
+}
+
+// LSD radix sort of `v` by record::digit, most significant digit 0. Passes whose
+// digit is constant across the slice are skipped, which drops the unused key bits.
+void radix_sort(record* v, record* scratch, size_t n) {
+    constexpr int digits = 17;
+    for (int d = digits - 1; d >= 0; --d) {
+        std::array<size_t, 257> count{};
+        for (size_t i = 0; i < n; ++i) count[v[i].digit(d) + 1]++;
+        if (std::any_of(count.begin(), count.end(), [n](size_t c) { return c == n; })) continue;
+        for (int b = 0; b < 256; ++b) count[b + 1] += count[b];
+        for (size_t i = 0; i < n; ++i) scratch[count[v[i].digit(d)]++] = v[i];
+        std::copy(scratch, scratch + n, v);
+    }
+}
+
+// Buffered reader over a binary run file
+class run_reader {
+private:
+    std::ifstream in;
+    std::vector<char> buffer;
+
+public:
+    record current;
+
+    run_reader(const std::string& name, size_t buffer_bytes) : buffer(std::max<size_t>(buffer_bytes, 4096)) {
+        in.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        in.open(name, std::ios::binary);
+    }
+
+    bool next() {
+        return bool(in.read(reinterpret_cast<char*>(&current), sizeof(record)));
+    }
+};
+
+// Merge sorted sources by `less`, handing each record to `emit`
+template<typename Less, typename Emit>
+void kway_merge(std::vector<std::unique_ptr<run_reader>>& sources, Less less, Emit emit) {
+    auto later = [&](size_t a, size_t b) { return less(sources[b]->current, sources[a]->current); };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heads(later);
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (sources[i]->next()) heads.push(i);
+    }
+    while (!heads.empty()) {
+        size_t i = heads.top();
+        heads.pop();
+        emit(sources[i]->current);
+        if (sources[i]->next()) heads.push(i);
+    }
+}
+
+struct merge_options {
+    size_t memory_bytes = size_t(256) << 20;
+    int num_threads = 1;
+    size_t fan_in = 64;
+    std::string tmp_prefix;
+};
+
+class archive_merger {
+private:
+    merge_options opt;
+    size_t chunk_records;
+    std::vector<record> chunk, scratch;
+    std::vector<std::string> runs;
+    size_t run_counter = 0;
+
+    std::string next_run_name() {
+        return opt.tmp_prefix + ".run" + std::to_string(run_counter++);
+    }
+
+    std::vector<std::unique_ptr<run_reader>> open_runs(const std::vector<std::string>& names, size_t budget) {
+        // Split the budget between the readers' buffers and the writer's
+        size_t per_reader = budget / (names.size() + 1);
+        std::vector<std::unique_ptr<run_reader>> sources;
+        for (auto& name : names) sources.emplace_back(new run_reader(name, per_reader));
+        return sources;
+    }
+
+    // Merge groups of runs sorted by `less` into longer runs until at most
+    // fan_in are left. Duplicates are kept for the final merge to count.
+    template<typename Less>
+    void reduce_runs(std::vector<std::string>& names, Less less, size_t budget) {
+        while (names.size() > opt.fan_in) {
+            std::vector<std::string> merged;
+            for (size_t begin = 0; begin < names.size(); begin += opt.fan_in) {
+                std::vector<std::string> group(names.begin() + begin,
+                                               names.begin() + std::min(names.size(), begin + opt.fan_in));
+                if (group.size() == 1) {
+                    merged.push_back(group[0]);
+                    continue;
+                }
+                std::string name = next_run_name();
+                {
+                    std::vector<char> buffer(std::max<size_t>(budget / (group.size() + 1), 4096));
+                    std::ofstream out;
+                    out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+                    out.open(name, std::ios::binary);
+                    auto sources = open_runs(group, budget);
+                    kway_merge(sources, less, [&](const record& r) {
+                        out.write(reinterpret_cast<const char*>(&r), sizeof(record));
+                    });
+                }
+                remove_all(group);
+                merged.push_back(name);
+            }
+            names.swap(merged);
+        }
+    }
+
+    // Sort the chunk by game in parallel slices, then merge the slices into a run
+    // file, dropping duplicates on the way
+    void flush_by_game() {
+        if (chunk.empty()) return;
+        size_t n = chunk.size();
+        size_t slices = std::min<size_t>(opt.num_threads, std::max<size_t>(1, n / 4096));
+        std::vector<size_t> bounds;
+        for (size_t s = 0; s <= slices; ++s) bounds.push_back(n * s / slices);
+        std::vector<std::thread> threads;
+        for (size_t s = 0; s < slices; ++s) {
+            threads.emplace_back([&, s] {
+                radix_sort(chunk.data() + bounds[s], scratch.data() + bounds[s], bounds[s + 1] - bounds[s]);
+            });
+        }
+        for (auto& t : threads) t.join();
+
+        std::string name = next_run_name();
+        std::ofstream out(name, std::ios::binary);
+        std::vector<size_t> pos(bounds.begin(), bounds.end() - 1);
+        bool have_last = false;
+        record last{};
+        while (true) {
+            size_t best = slices;
+            for (size_t s = 0; s < slices; ++s) {
+                if (pos[s] < bounds[s + 1] && (best == slices || record::by_game(chunk[pos[s]], chunk[pos[best]]))) {
+                    best = s;
+                }
+            }
+            if (best == slices) break;
+            const record& r = chunk[pos[best]++];
+            if (!have_last || !r.same_game(last)) {
+                out.write(reinterpret_cast<const char*>(&r), sizeof(record));
+                last = r;
+                have_last = true;
+            }
+        }
+        runs.push_back(name);
+        chunk.clear();
+    }
+
+    void flush_by_rank(std::vector<std::string>& ranked) {
+        if (chunk.empty()) return;
+        std::sort(chunk.begin(), chunk.end(), record::by_rank);
+        std::string name = next_run_name();
+        std::ofstream out(name, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size() * sizeof(record));
+        ranked.push_back(name);
+        chunk.clear();
+    }
+
+    static void remove_all(const std::vector<std::string>& names) {
+        for (auto& name : names) std::remove(name.c_str());
+    }
+
+public:
+    size_t read = 0, rejected = 0, unique = 0, conflicts = 0;
+
+    explicit archive_merger(const merge_options& opt) : opt(opt) {
+        // Records and their radix scratch space share the budget
+        chunk_records = std::max<size_t>(1024, opt.memory_bytes / (2 * sizeof(record)));
+        chunk.reserve(chunk_records);
+        scratch.resize(chunk_records);
+    }
+
+    void add_file(const std::string& name) {
+        std::ifstream in(name);
+        if (!in.is_open()) throw std::runtime_error("cannot open " + name);
+        std::string line;
+        record r;
+        while (std::getline(in, line)) {
+            if (!parse_record(line, r)) {
+                if (!line.empty()) rejected++;
+                continue;
+            }
+            read++;
+            chunk.push_back(r);
+            if (chunk.size() == chunk_records) flush_by_game();
+        }
+    }
+
+    void write(const std::string& output) {
+        flush_by_game();
+
+        // The radix scratch space is not needed any more. The chunk collects
+        // the ranked runs and keeps half of the budget; the readers get the rest.
+        std::vector<record>().swap(scratch);
+        size_t held = chunk.capacity() * sizeof(record);
+        size_t read_budget = opt.memory_bytes > held ? opt.memory_bytes - held : 0;
+
+        // Merge the game-sorted runs, keep one record per game, and cut ranked runs
+        std::vector<std::string> ranked;
+        reduce_runs(runs, record::by_game, read_budget);
+        {
+            auto sources = open_runs(runs, read_budget);
+            bool have_last = false;
+            record last{};
+            kway_merge(sources, record::by_game, [&](const record& r) {
+                if (have_last && r.same_game(last)) {
+                    if (r.score != last.score || r.tricks != last.tricks || r.winner != last.winner) conflicts++;
+                    return;
+                }
+                last = r;
+                have_last = true;
+                unique++;
+                chunk.push_back(r);
+                if (chunk.size() == chunk_records) flush_by_rank(ranked);
+            });
+        }
+        remove_all(runs);
+        flush_by_rank(ranked);
+        std::vector<record>().swap(chunk);
+
+        reduce_runs(ranked, record::by_rank, opt.memory_bytes);
+        std::ofstream out(output);
+        if (!out.is_open()) throw std::runtime_error("cannot open " + output);
+        {
+            auto sources = open_runs(ranked, opt.memory_bytes);
+            kway_merge(sources, record::by_rank, [&](const record& r) { write_record(out, r); });
+        }
+        remove_all(ranked);
+    }
+};
+
+int main(int argc, char* argv[]) {
+    merge_options opt;
+    opt.num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Parse command line arguments: <output> <input>... [options]
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--mem" && has_value) {
+            opt.memory_bytes = std::stoull(argv[++i]) << 20;
+        } else if (arg == "--threads" && has_value) {
+            opt.num_threads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--fan-in" && has_value) {
+            opt.fan_in = std::max(2, std::stoi(argv[++i]));
+        } else if (arg == "--tmp" && has_value) {
+            opt.tmp_prefix = argv[++i];
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() < 2) {
+        std::cout << "Usage: " << argv[0] << " <output> <input>... [--mem MB] [--threads N] [--fan-in N] [--tmp PREFIX]" << std::endl;
+        std::cout << "Inputs are result files in high_score.txt format" << std::endl;
+        return 1;
+    }
+    if (opt.tmp_prefix.empty()) opt.tmp_prefix = positional[0];
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    archive_merger merger(opt);
+    try {
+        for (size_t i = 1; i < positional.size(); ++i) merger.add_file(positional[i]);
+        merger.write(positional[0]);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    std::cout << "Read " << merger.read << " records";
+    if (merger.rejected > 0) std::cout << " (" << merger.rejected << " malformed lines skipped)";
+    std::cout << ", wrote " << merger.unique << " unique games to " << positional[0] << " in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms" << std::endl;
+    if (merger.conflicts > 0) {
+        std::cout << "Warning: " << merger.conflicts << " duplicate games with differing results" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Compares hand representations for branching searches, which fork the game
+// state at every branch point. Three representations run the same workload:
+//
+//   vector: std::vector<int> hands as in main-imp.cpp; a fork copies both hands
+//   ring:   fixed 52-byte ring buffers as in synth.cpp; a fork is a flat copy
+//   rope:   persistent hands of immutable, reference-counted segments; a fork
+//           copies three pointers per hand, and a trick pickup appends the pile
+//           as one new segment without touching the rest of the hand
+//
+// The workload plays each deal and, at every trick boundary of the game, grows a
+// tree of forks: every node forks `branch` children, each played on to its next
+// trick boundary, down to `depth` levels. Child b > 0 first replaces the next
+// card of the player to move by (card + b) % 5, so that siblings play different
+// tricks as in a search over alternatives. Every representation must produce
+// the same checksum over the leaves.
+
+constexpr int deck_size = 52;
+constexpr int max_moves = 10000; // same limit as main-imp.cpp
+
+// Hand as in main-imp.cpp
+class vector_hand {
+private:
+    std::vector<int> cards;
+
+public:
+    void assign(const uint8_t* begin, const uint8_t* end) { cards.assign(begin, end); }
+    int size() const { return int(cards.size()); }
+    int front() const { return cards.front(); }
+    void set_front(int card) { cards.front() = card; }
+    void pop_front() { cards.erase(cards.begin()); }
+    void append(const uint8_t* pile, int n) { cards.insert(cards.end(), pile, pile + n); }
+};
+
+// Hand as in synth.cpp
+class ring_hand {
+private:
+    uint8_t cards[deck_size];
+    uint8_t head = 0, count = 0;
+
+public:
+    void assign(const uint8_t* begin, const uint8_t* end) {
+        count = uint8_t(std::copy(begin, end, cards) - cards);
+        head = 0;
+    }
+    int size() const { return count; }
+    int front() const { return cards[head]; }
+    void set_front(int card) { cards[head] = uint8_t(card); }
+    void pop_front() {
+        head = uint8_t((head + 1) % deck_size);
+        count--;
+    }
+    void append(const uint8_t* pile, int n) {
+        for (int i = 0; i < n; ++i) cards[(head + count + i) % deck_size] = pile[i];
+        count = uint8_t(count + n);
+    }
+};
+
+// Persistent hand: the cards are a sequence of immutable segments. The front
+// segment is read from an offset; the segments after it are a shared list in
+// order, and appended segments a shared list newest first. When the front
+// segment runs out the appended list is reversed into order, which is the only
+// step that is not O(1) and is amortised over the cards of those segments.
+class rope_hand {
+private:
+    struct segment {
+        std::vector<uint8_t> cards;
+    };
+    struct node {
+        std::shared_ptr<const segment> seg;
+        std::shared_ptr<const node> next;
+    };
+
+    std::shared_ptr<const segment> head;
+    std::shared_ptr<const node> ahead; // segments after `head`, in order
+    std::shared_ptr<const node> back;  // appended segments, newest first
+    uint16_t offset = 0;
+    uint16_t count = 0;
+
+    void next_segment() {
+        if (!ahead) {
+            std::shared_ptr<const node> reversed;
+            for (const node* n = back.get(); n; n = n->next.get()) {
+                reversed = std::make_shared<const node>(node{n->seg, reversed});
+            }
+            ahead = std::move(reversed);
+            back.reset();
+        }
+        if (ahead) {
+            head = ahead->seg;
+            ahead = ahead->next;
+        } else {
+            head.reset();
+        }
+        offset = 0;
+    }
+
+public:
+    void assign(const uint8_t* begin, const uint8_t* end) {
+        head = std::make_shared<const segment>(segment{std::vector<uint8_t>(begin, end)});
+        ahead.reset();
+        back.reset();
+        offset = 0;
+        count = uint16_t(end - begin);
+    }
+    int size() const { return count; }
+    int front() const { return head->cards[offset]; }
+    // Segments are shared, so the rest of the front segment is copied first
+    void set_front(int card) {
+        auto seg = std::make_shared<segment>(segment{std::vector<uint8_t>(head->cards.begin() + offset, head->cards.end())});
+        seg->cards[0] = uint8_t(card);
+        head = std::move(seg);
+        offset = 0;
+    }
+    void pop_front() {
+        count--;
+        if (++offset == head->cards.size()) next_segment();
+    }
+    void append(const uint8_t* pile, int n) {
+        auto seg = std::make_shared<const segment>(segment{std::vector<uint8_t>(pile, pile + n)});
+        if (count == 0) {
+            head = std::move(seg);
+            offset = 0;
+        } else {
+            back = std::make_shared<const node>(node{std::move(seg), back});
+        }
+        count = uint16_t(count + n);
+    }
+};
+
+// Game with the rules from main-imp.cpp over any hand representation
+template <class Hand>
+struct branch_game {
+    Hand hands[2];
+    uint8_t pile[deck_size];
+    int pile_size = 0;
+    int active = 0;
+    int remaining_penalties = 0;
+    int moves = 0;
+    int tricks = 0;
+
+    explicit branch_game(const std::vector<uint8_t>& deal) {
+        hands[0].assign(deal.data(), deal.data() + deck_size / 2);
+        hands[1].assign(deal.data() + deck_size / 2, deal.data() + deck_size);
+    }
+
+    bool over() const {
+        return hands[0].size() == 0 || hands[1].size() == 0;
+    }
+
+    // Over, or stopped at the move limit like a cycling game in main-imp.cpp
+    bool finished() const {
+        return over() || moves >= max_moves;
+    }
+
+    // Play until the next trick is picked up or the game finishes
+    void play_trick() {
+        while (!finished()) {
+            int card = hands[active].front();
+            hands[active].pop_front();
+            pile[pile_size++] = uint8_t(card);
+            moves++;
+            if (card > 0) {
+                remaining_penalties = card;
+                active ^= 1;
+            } else if (remaining_penalties > 0) {
+                if (--remaining_penalties == 0) {
+                    tricks++;
+                    hands[active].append(pile, pile_size);
+                    pile_size = 0;
+                    return;
+                }
+                active ^= 1;
+            } else {
+                active ^= 1;
+            }
+        }
+    }
+};
+
+struct workload {
+    int branch = 2;
+    int depth = 8;
+};
+
+struct workload_counts {
+    long forks = 0;
+    long moves = 0;
+    uint64_t checksum = 0;
+};
+
+template <class Hand>
+void explore(const branch_game<Hand>& node, int level, const workload& w, workload_counts& out) {
+    if (level == w.depth || node.finished()) {
+        out.checksum = out.checksum * 1000003 + uint64_t(node.moves * 64 + node.hands[0].size() * 2 + node.active);
+        return;
+    }
+    for (int b = 0; b < w.branch; ++b) {
+        branch_game<Hand> child = node;
+        out.forks++;
+        if (b > 0) {
+            Hand& mover = child.hands[child.active];
+            mover.set_front((mover.front() + b) % 5);
+        }
+        int before = child.moves;
+        child.play_trick();
+        out.moves += child.moves - before;
+        explore(child, level + 1, w, out);
+    }
+}
+
+template <class Hand>
+workload_counts run_workload(const std::vector<std::vector<uint8_t>>& deals, const workload& w) {
+    workload_counts out;
+    for (auto& deal : deals) {
+        branch_game<Hand> game(deal);
+        while (!game.finished()) {
+            explore(game, 0, w, out);
+            int before = game.moves;
+            game.play_trick();
+            out.moves += game.moves - before;
+        }
+    }
+    return out;
+}
+
+std::vector<uint8_t> parse_deal(const std::string& s) {
+    std::vector<uint8_t> deal(deck_size, 0);
+    for (size_t i = 0; i < std::min(s.size(), size_t(deck_size)); ++i) {
+        switch (s[i]) {
+            case 'J': deal[i] = 1; break;
+            case 'Q': deal[i] = 2; break;
+            case 'K': deal[i] = 3; break;
+            case 'A': deal[i] = 4; break;
+        }
+    }
+    return deal;
+}
+
+template <class Hand>
+workload_counts bench(const char* name, const std::vector<std::vector<uint8_t>>& deals, const workload& w) {
+    auto start = std::chrono::high_resolution_clock::now();
+    workload_counts c = run_workload<Hand>(deals, w);
+    auto end = std::chrono::high_resolution_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << name << ": " << ns / 1e6 << " ms, " << ns / double(c.forks) << " ns per fork, "
+              << ns / double(c.moves) << " ns per move" << std::endl;
+    return c;
+}
+
+int main(int argc, char* argv[]) {
+    workload w;
+    std::string file_name = "high_score.txt";
+    int num_deals = 5;
+    std::vector<std::string> positional;
+
+    // Parse command line arguments: [deck]... [--file F] [--deals N] [--branch B] [--depth D]
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--file" && has_value) {
+            file_name = argv[++i];
+        } else if (arg == "--deals" && has_value) {
+            num_deals = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--branch" && has_value) {
+            w.branch = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--depth" && has_value) {
+            w.depth = std::max(0, std::stoi(argv[++i]));
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cout << "Usage: " << argv[0] << " [deck]... [--file F] [--deals N] [--branch B] [--depth D]" << std::endl;
+            std::cout << "Without decks, the N longest games of F (high_score.txt format) are used" << std::endl;
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> deals;
+    for (auto& s : positional) deals.push_back(parse_deal(s));
+    if (deals.empty()) {
+        // The longest games: the last lines of a high score file
+        std::ifstream in(file_name);
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(in, line);) {
+            if (!line.empty()) lines.push_back(line);
+        }
+        for (size_t i = lines.size() > size_t(num_deals) ? lines.size() - num_deals : 0; i < lines.size(); ++i) {
+            std::stringstream ss(lines[i]);
+            std::string field;
+            for (int f = 0; f < 4 && std::getline(ss, field, ','); ++f) {}
+            deals.push_back(parse_deal(field));
+        }
+    }
+    if (deals.empty()) {
+        std::cerr << "Error: no deals given and none found in '" << file_name << "'" << std::endl;
+        return 1;
+    }
+
+    std::cout << deals.size() << " deals, branch " << w.branch << ", depth " << w.depth << std::endl;
+    workload_counts results[] = {
+        bench<vector_hand>("vector", deals, w),
+        bench<ring_hand>("ring  ", deals, w),
+        bench<rope_hand>("rope  ", deals, w),
+    };
+    std::cout << results[0].forks << " forks, " << results[0].moves << " moves" << std::endl;
+    if (results[0].checksum != results[1].checksum || results[0].checksum != results[2].checksum) {
+        std::cerr << "Error: representations disagree" << std::endl;
+        return 1;
+    }
+    return 0;
+}
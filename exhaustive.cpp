@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+// Solves every deal of a reduced deck with the rules from main-imp.cpp: `size`
+// cards of which `faces` copies each of J, Q, K and A, split in two halves,
+// player 1 leading. The result is ground truth for searches and engines: the
+// exact distribution of game lengths, the longest games, and every deal that
+// never ends.
+//
+// The engine is templated on the deck size so that hands and pile are fixed
+// arrays. Cycles are found exactly with Brent's algorithm over the states at
+// trick boundaries (empty pile, no penalty), which hold the whole game state:
+// a game that never ends passes infinitely many of them, and repeats one.
+
+// Card representation: 0=non-face card, 1=J, 2=Q, 3=K, 4=A
+struct reduced_result {
+    int winner;      // 1 or 2, or -1 for a cycle
+    int moves;       // cards played until the end, or until the cycle was seen
+    int tricks;
+    int cycle_tricks; // length of the cycle in tricks
+};
+
+template <int Size>
+class reduced_game {
+private:
+    static constexpr int half = Size / 2;
+
+    uint8_t hand[2][Size];
+    int head[2], count[2];
+    uint8_t pile[Size];
+    int pile_size = 0;
+
+    // Hands in play order and the player to move, at a trick boundary
+    struct snapshot {
+        uint8_t bytes[Size + 2];
+    };
+
+    void take(snapshot& s, int active) const {
+        int n = 0;
+        s.bytes[n++] = uint8_t(count[0] | active << 7);
+        for (int p = 0; p < 2; ++p) {
+            for (int i = 0; i < count[p]; ++i) s.bytes[n++] = hand[p][(head[p] + i) % Size];
+        }
+    }
+
+    static bool same(const snapshot& a, const snapshot& b) {
+        return std::memcmp(a.bytes, b.bytes, Size + 1) == 0;
+    }
+
+public:
+    reduced_result play(const uint8_t* deal) {
+        for (int p = 0; p < 2; ++p) {
+            std::copy(deal + p * half, deal + (p + 1) * half, hand[p]);
+            head[p] = 0;
+            count[p] = half;
+        }
+        pile_size = 0;
+        int active = 0;
+        int remaining_penalties = 0;
+        int moves = 0, tricks = 0;
+
+        snapshot saved, current;
+        take(saved, active);
+        long power = 1, lambda = 0;
+
+        while (count[0] > 0 && count[1] > 0) {
+            int card = hand[active][head[active]];
+            head[active] = (head[active] + 1) % Size;
+            count[active]--;
+            pile[pile_size++] = uint8_t(card);
+            moves++;
+
+            if (card > 0) {
+                remaining_penalties = card;
+                active ^= 1;
+            } else if (remaining_penalties > 0) {
+                if (--remaining_penalties == 0) {
+                    tricks++;
+                    for (int i = 0; i < pile_size; ++i) {
+                        hand[active][(head[active] + count[active]) % Size] = pile[i];
+                        count[active]++;
+                    }
+                    pile_size = 0;
+
+                    take(current, active);
+                    if (same(current, saved)) {
+                        return {-1, moves, tricks, int(lambda + 1)};
+                    }
+                    if (++lambda == power) {
+                        saved = current;
+                        power *= 2;
+                        lambda = 0;
+                    }
+                } else {
+                    active ^= 1;
+                }
+            } else {
+                active ^= 1;
+            }
+        }
+        return {active + 1, moves, tricks, 0};
+    }
+};
+
+// Straightforward engine for cross-checks: vectors, and a set of every full
+// state seen so far, as in main-imp.cpp
+reduced_result reference_play(const std::vector<int>& deal) {
+    std::vector<int> hands[2] = {std::vector<int>(deal.begin(), deal.begin() + deal.size() / 2),
+                                 std::vector<int>(deal.begin() + deal.size() / 2, deal.end())};
+    std::vector<int> pile;
+    int active = 0, remaining_penalties = 0, moves = 0, tricks = 0;
+    std::set<std::vector<int>> seen;
+    while (!hands[0].empty() && !hands[1].empty()) {
+        std::vector<int> state = hands[0];
+        state.push_back(-1);
+        state.insert(state.end(), hands[1].begin(), hands[1].end());
+        state.push_back(-1);
+        state.insert(state.end(), pile.begin(), pile.end());
+        state.push_back(-active - 1);
+        state.push_back(remaining_penalties);
+        if (!seen.insert(state).second) {
+            return {-1, moves, tricks, 0};
+        }
+
+        int card = hands[active].front();
+        hands[active].erase(hands[active].begin());
+        pile.push_back(card);
+        moves++;
+        if (card > 0) {
+            remaining_penalties = card;
+            active ^= 1;
+        } else if (remaining_penalties > 0) {
+            if (--remaining_penalties == 0) {
+                tricks++;
+                hands[active].insert(hands[active].end(), pile.begin(), pile.end());
+                pile.clear();
+            } else {
+                active ^= 1;
+            }
+        } else {
+            active ^= 1;
+        }
+    }
+    return {active + 1, moves, tricks, 0};
+}
+
+std::string deal_string(const uint8_t* deal, int size) {
+    static const char names[] = "-JQKA";
+    std::string s;
+    for (int i = 0; i < size; ++i) s += names[deal[i]];
+    return s;
+}
+
+struct solve_options {
+    int size = 20;
+    int faces = 1;
+    int top = 10;
+    long verify_every = 0;
+    int num_threads = 1;
+    std::string lengths_file;
+    std::string cycles_file;
+};
+
+struct solve_totals {
+    uint64_t deals = 0;
+    uint64_t wins[2] = {0, 0};
+    std::map<int, uint64_t> lengths; // moves -> finished deals
+    std::vector<std::tuple<int, int, int, std::string>> longest; // moves, tricks, winner, deal
+    std::vector<std::pair<std::string, int>> cycles;             // deal, cycle length in tricks
+    uint64_t verified = 0;
+    uint64_t mismatches = 0;
+    int threshold = 0; // shortest game still kept in `longest`
+
+    void keep_longest(int top) {
+        std::sort(longest.begin(), longest.end(), [](const auto& a, const auto& b) {
+            return std::get<0>(a) != std::get<0>(b) ? std::get<0>(a) > std::get<0>(b) : std::get<3>(a) < std::get<3>(b);
+        });
+        if (int(longest.size()) > top) longest.resize(top);
+    }
+
+    void merge(solve_totals& other, int top) {
+        deals += other.deals;
+        wins[0] += other.wins[0];
+        wins[1] += other.wins[1];
+        for (auto& [moves, n] : other.lengths) lengths[moves] += n;
+        longest.insert(longest.end(), other.longest.begin(), other.longest.end());
+        keep_longest(top);
+        cycles.insert(cycles.end(), other.cycles.begin(), other.cycles.end());
+        verified += other.verified;
+        mismatches += other.mismatches;
+    }
+};
+
+// Every deal is a choice of face card positions and an order of the face cards
+// on them. Thread t takes every num_threads-th set of positions.
+template <int Size>
+solve_totals solve(const solve_options& opt) {
+    const int face_count = 4 * opt.faces;
+    std::vector<solve_totals> results(opt.num_threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < opt.num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            solve_totals& out = results[t];
+            reduced_game<Size> g;
+            uint8_t deal[Size];
+            std::vector<int> faces;
+            for (int v = 1; v <= 4; ++v) faces.insert(faces.end(), opt.faces, v);
+
+            // Positions as a bitmask over the deck, enumerated in colex order
+            std::vector<bool> chosen(Size, false);
+            std::fill(chosen.end() - face_count, chosen.end(), true);
+            long combination = 0;
+            do {
+                if (combination++ % opt.num_threads != t) continue;
+                std::vector<int> order = faces;
+                do {
+                    int k = 0;
+                    for (int i = 0; i < Size; ++i) deal[i] = uint8_t(chosen[i] ? order[k++] : 0);
+                    reduced_result r = g.play(deal);
+                    out.deals++;
+                    if (r.winner > 0) {
+                        out.wins[r.winner - 1]++;
+                        out.lengths[r.moves]++;
+                        if (r.moves >= out.threshold) {
+                            out.longest.emplace_back(r.moves, r.tricks, r.winner, deal_string(deal, Size));
+                            if (int(out.longest.size()) >= 4 * opt.top) {
+                                out.keep_longest(opt.top);
+                                out.threshold = std::get<0>(out.longest.back());
+                            }
+                        }
+                    } else {
+                        out.cycles.emplace_back(deal_string(deal, Size), r.cycle_tricks);
+                    }
+                    if (opt.verify_every > 0 && out.deals % opt.verify_every == 0) {
+                        reduced_result ref = reference_play(std::vector<int>(deal, deal + Size));
+                        out.verified++;
+                        bool same = ref.winner == r.winner && (r.winner < 0 || (ref.moves == r.moves && ref.tricks == r.tricks));
+                        if (!same) out.mismatches++;
+                    }
+                } while (std::next_permutation(order.begin(), order.end()));
+            } while (std::next_permutation(chosen.begin(), chosen.end()));
+            out.keep_longest(opt.top);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    solve_totals total;
+    for (auto& r : results) total.merge(r, opt.top);
+    std::sort(total.cycles.begin(), total.cycles.end());
+    return total;
+}
+
+// Deck sizes the solver is built for
+solve_totals solve_size(const solve_options& opt) {
+    switch (opt.size) {
+        case 8: return solve<8>(opt);
+        case 10: return solve<10>(opt);
+        case 12: return solve<12>(opt);
+        case 14: return solve<14>(opt);
+        case 16: return solve<16>(opt);
+        case 18: return solve<18>(opt);
+        case 20: return solve<20>(opt);
+        case 22: return solve<22>(opt);
+        case 24: return solve<24>(opt);
+        case 26: return solve<26>(opt);
+        case 28: return solve<28>(opt);
+        case 30: return solve<30>(opt);
+        case 32: return solve<32>(opt);
+        default: throw std::invalid_argument("deck size must be even and between 8 and 32");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    solve_options opt;
+    opt.num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Parse command line arguments: [size] [faces] [options]
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--top" && has_value) {
+            opt.top = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--verify" && has_value) {
+            opt.verify_every = std::stol(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            opt.num_threads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--lengths" && has_value) {
+            opt.lengths_file = argv[++i];
+        } else if (arg == "--cycles" && has_value) {
+            opt.cycles_file = argv[++i];
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cout << "Usage: " << argv[0] << " [size] [faces] [--top N] [--verify K] [--threads N]"
+                      << " [--lengths FILE] [--cycles FILE]" << std::endl;
+            std::cout << "Solves every deal of `size` cards with `faces` copies of each face card" << std::endl;
+            std::cout << "--verify K replays every K-th deal of each thread with a reference engine" << std::endl;
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() > 0) opt.size = std::stoi(positional[0]);
+    if (positional.size() > 1) opt.faces = std::stoi(positional[1]);
+    if (opt.faces < 1 || 4 * opt.faces > opt.size) {
+        std::cerr << "Error: need 1 <= faces and 4 * faces <= size" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Solving all deals of " << opt.size << " cards with " << opt.faces << " of each face card on "
+              << opt.num_threads << " threads" << std::endl;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    solve_totals total;
+    try {
+        total = solve_size(opt);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    uint64_t finished = total.wins[0] + total.wins[1];
+    double mean = 0;
+    for (auto& [moves, n] : total.lengths) mean += double(moves) * double(n);
+    std::cout << "Solved " << total.deals << " deals in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms: "
+              << total.wins[0] << " won by player 1, " << total.wins[1] << " by player 2, "
+              << total.cycles.size() << " cycles" << std::endl;
+    if (finished > 0) {
+        std::cout << "Mean length " << mean / double(finished) << " cards, longest " << total.lengths.rbegin()->first
+                  << " cards" << std::endl;
+    }
+    std::cout << "Longest games (cards,tricks,winner,deck):" << std::endl;
+    for (auto& [moves, tricks, winner, deal] : total.longest) {
+        std::cout << moves << "," << tricks << "," << winner << "," << deal << std::endl;
+    }
+    if (opt.verify_every > 0) {
+        std::cout << "Reference engine: " << total.verified << " deals replayed, " << total.mismatches << " mismatches" << std::endl;
+    }
+
+    if (!opt.lengths_file.empty()) {
+        std::ofstream out(opt.lengths_file);
+        out << "cards,deals\n";
+        for (auto& [moves, n] : total.lengths) out << moves << "," << n << "\n";
+    }
+    if (!opt.cycles_file.empty()) {
+        std::ofstream out(opt.cycles_file);
+        for (auto& [deal, length] : total.cycles) out << deal << "," << length << "\n";
+    }
+    return total.mismatches > 0 ? 2 : 0;
+}
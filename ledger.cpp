@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+// Coverage ledger for work handed out as numbered index ranges, e.g. blocks of
+// an enumeration of the deal space split over many runs and machines. Workers
+// report the ranges they finished; the ledger merges the reports, and a
+// scheduler asks it for ranges that are not covered yet.
+//
+// Range numbers are split like a roaring bitmap: the high bits select a block
+// of 2^16 consecutive ranges, and each block stores its covered ranges as runs
+// of consecutive numbers, or as a bitmap once the runs would take more space.
+// Completed work tends to be contiguous, so billions of ranges usually fit in a
+// few runs per block. In the file a block is written in whichever of array,
+// bitmap or run form is smallest. The file header holds the covered count, so
+// coverage queries do not read the blocks at all.
+//
+// Updates take a lock file, write the new ledger to a temporary file, sync it
+// and rename it over the old one, so readers always see a complete ledger.
+
+constexpr char ledger_magic[8] = {'B', 'M', 'N', 'C', 'L', '1', 0, 0};
+constexpr uint64_t block_size = 1 << 16;
+constexpr uint64_t default_total = uint64_t(1) << 63; // ranges are numbered below 2^63
+
+struct ledger_header {
+    char magic[8];
+    uint64_t total;   // size of the range space, for percentages and gap queries
+    uint64_t covered;
+    uint64_t blocks;
+};
+
+enum class block_form : uint8_t { array, bitmap, runs };
+
+// Covered ranges within one block of 2^16
+struct block {
+    static constexpr int words = block_size / 64;
+    static constexpr size_t max_runs = words * sizeof(uint64_t) / 4; // where runs outgrow the bitmap
+
+    std::vector<std::pair<uint32_t, uint32_t>> runs; // [first, last], sorted, disjoint and not adjacent
+    std::vector<uint64_t> bits;                      // used instead of runs when not empty
+    uint32_t count = 0;
+
+    bool dense() const { return !bits.empty(); }
+
+    // Cover [first, last]
+    void add(uint32_t first, uint32_t last) {
+        if (dense()) {
+            for (uint32_t w = first >> 6; w <= last >> 6; ++w) {
+                uint64_t mask = ~uint64_t(0);
+                if (w == first >> 6) mask &= ~uint64_t(0) << (first & 63);
+                if (w == last >> 6) mask &= ~uint64_t(0) >> (63 - (last & 63));
+                count += uint32_t(__builtin_popcountll(mask & ~bits[w]));
+                bits[w] |= mask;
+            }
+            return;
+        }
+        // Absorb every run that overlaps or touches [first, last]
+        auto it = std::lower_bound(runs.begin(), runs.end(), first,
+                                   [](const std::pair<uint32_t, uint32_t>& r, uint32_t v) { return r.second + 1 < v; });
+        auto end = it;
+        while (end != runs.end() && end->first <= last + 1) {
+            first = std::min(first, end->first);
+            last = std::max(last, end->second);
+            count -= end->second - end->first + 1;
+            ++end;
+        }
+        it = runs.erase(it, end);
+        runs.insert(it, {first, last});
+        count += last - first + 1;
+        if (runs.size() > max_runs) to_bitmap();
+    }
+
+    void merge(const block& other) {
+        if (other.dense()) {
+            if (!dense()) to_bitmap();
+            count = 0;
+            for (int w = 0; w < words; ++w) {
+                bits[w] |= other.bits[w];
+                count += uint32_t(__builtin_popcountll(bits[w]));
+            }
+        } else {
+            for (auto& r : other.runs) add(r.first, r.second);
+        }
+    }
+
+    // First number >= x whose bit is `value` in the bitmap, or block_size
+    uint32_t scan(uint32_t x, bool value) const {
+        for (uint32_t w = x >> 6; w < uint32_t(words); ++w) {
+            uint64_t word = (value ? bits[w] : ~bits[w]) & (w == x >> 6 ? ~uint64_t(0) << (x & 63) : ~uint64_t(0));
+            if (word) return w * 64 + uint32_t(__builtin_ctzll(word));
+        }
+        return uint32_t(block_size);
+    }
+
+    // First number >= x that is not covered, or block_size
+    uint32_t next_gap(uint32_t x) const {
+        if (dense()) return scan(x, false);
+        auto it = std::lower_bound(runs.begin(), runs.end(), x,
+                                   [](const std::pair<uint32_t, uint32_t>& r, uint32_t v) { return r.second < v; });
+        return it != runs.end() && it->first <= x ? it->second + 1 : x;
+    }
+
+    // First covered number >= x, or block_size
+    uint32_t next_covered(uint32_t x) const {
+        if (dense()) return scan(x, true);
+        auto it = std::lower_bound(runs.begin(), runs.end(), x,
+                                   [](const std::pair<uint32_t, uint32_t>& r, uint32_t v) { return r.second < v; });
+        return it == runs.end() ? uint32_t(block_size) : std::max(it->first, x);
+    }
+
+    void to_bitmap() {
+        bits.assign(words, 0);
+        auto old = std::move(runs);
+        runs.clear();
+        count = 0;
+        for (auto& r : old) add(r.first, r.second);
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> run_list() const {
+        if (!dense()) return runs;
+        std::vector<std::pair<uint32_t, uint32_t>> out;
+        for (uint32_t x = next_covered(0); x < block_size; x = next_covered(next_gap(x))) {
+            out.push_back({x, next_gap(x) - 1});
+        }
+        return out;
+    }
+
+    // Smallest encoding: 2 bytes per number, 8 KB, or 4 bytes per run
+    block_form best_form(size_t num_runs) const {
+        size_t array_bytes = 2 * size_t(count), bitmap_bytes = words * sizeof(uint64_t), run_bytes = 4 * num_runs;
+        if (run_bytes <= array_bytes && run_bytes <= bitmap_bytes) return block_form::runs;
+        return array_bytes <= bitmap_bytes ? block_form::array : block_form::bitmap;
+    }
+};
+
+class coverage_ledger {
+private:
+    std::map<uint64_t, block> blocks; // by range number / 2^16
+
+public:
+    uint64_t total = default_total;
+    uint64_t covered = 0;
+
+    // Cover ranges [begin, end)
+    void add(uint64_t begin, uint64_t end) {
+        end = std::min(end, total);
+        while (begin < end) {
+            uint64_t key = begin / block_size;
+            uint64_t stop = std::min(end, (key + 1) * block_size);
+            block& b = blocks[key];
+            uint32_t before = b.count;
+            b.add(uint32_t(begin % block_size), uint32_t((stop - 1) % block_size));
+            covered += b.count - before;
+            begin = stop;
+        }
+    }
+
+    // Merge another ledger. A ledger without a total takes the other's; two
+    // different totals mean the ledgers count different range spaces.
+    void merge(const coverage_ledger& other) {
+        if (other.total != default_total && other.total != total) {
+            if (total != default_total) {
+                throw std::runtime_error("report total " + std::to_string(other.total) +
+                                         " does not match ledger total " + std::to_string(total));
+            }
+            total = other.total;
+        }
+        for (auto& [key, other_block] : other.blocks) {
+            block& b = blocks[key];
+            uint32_t before = b.count;
+            b.merge(other_block);
+            covered += b.count - before;
+        }
+    }
+
+    bool contains(uint64_t x) const {
+        auto it = blocks.find(x / block_size);
+        if (it == blocks.end()) return false;
+        return it->second.next_gap(uint32_t(x % block_size)) != x % block_size;
+    }
+
+    // Uncovered ranges from `from` on, as [begin, end) intervals holding at most
+    // `limit` ranges in all
+    std::vector<std::pair<uint64_t, uint64_t>> gaps(uint64_t from, uint64_t limit) const {
+        std::vector<std::pair<uint64_t, uint64_t>> out;
+        uint64_t pos = from;
+        while (limit > 0 && pos < total) {
+            uint64_t key = pos / block_size;
+            uint64_t base = key * block_size;
+            uint64_t begin = pos, end = std::min(total, base + block_size);
+            auto it = blocks.find(key);
+            if (it != blocks.end()) {
+                uint32_t gap = it->second.next_gap(uint32_t(pos - base));
+                if (gap == block_size) {
+                    pos = base + block_size;
+                    continue;
+                }
+                begin = base + gap;
+                end = std::min(total, base + it->second.next_covered(gap));
+            }
+            end = std::min(end, begin + limit);
+            if (!out.empty() && out.back().second == begin) {
+                out.back().second = end;
+            } else {
+                out.push_back({begin, end});
+            }
+            limit -= end - begin;
+            pos = end;
+        }
+        return out;
+    }
+
+    size_t block_count() const { return blocks.size(); }
+
+    static ledger_header read_header(std::istream& in, const std::string& file_name) {
+        ledger_header h;
+        if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) || std::memcmp(h.magic, ledger_magic, sizeof(h.magic)) != 0) {
+            throw std::runtime_error("'" + file_name + "' is not a coverage ledger");
+        }
+        return h;
+    }
+
+    void load(const std::string& file_name) {
+        std::ifstream in(file_name, std::ios::binary);
+        if (!in) throw std::runtime_error("cannot open '" + file_name + "'");
+        ledger_header h = read_header(in, file_name);
+        coverage_ledger loaded;
+        loaded.total = h.total;
+        for (uint64_t i = 0; i < h.blocks; ++i) {
+            uint64_t key;
+            uint8_t form;
+            uint32_t n;
+            in.read(reinterpret_cast<char*>(&key), sizeof(key));
+            in.read(reinterpret_cast<char*>(&form), sizeof(form));
+            in.read(reinterpret_cast<char*>(&n), sizeof(n));
+            block& b = loaded.blocks[key];
+            if (form == uint8_t(block_form::bitmap)) {
+                b.bits.resize(block::words);
+                in.read(reinterpret_cast<char*>(b.bits.data()), block::words * sizeof(uint64_t));
+                for (uint64_t w : b.bits) b.count += uint32_t(__builtin_popcountll(w));
+            } else {
+                std::vector<uint16_t> values(form == uint8_t(block_form::runs) ? 2 * size_t(n) : n);
+                in.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(uint16_t));
+                for (size_t j = 0; j < values.size(); j += (form == uint8_t(block_form::runs) ? 2 : 1)) {
+                    uint32_t first = values[j];
+                    uint32_t last = form == uint8_t(block_form::runs) ? values[j + 1] : first;
+                    b.add(first, last);
+                }
+            }
+            loaded.covered += b.count;
+        }
+        if (!in || loaded.covered != h.covered) {
+            throw std::runtime_error("'" + file_name + "' is truncated or corrupt");
+        }
+        *this = std::move(loaded);
+    }
+
+    // Write to a temporary file and rename it over the ledger
+    void save(const std::string& file_name) const {
+        std::string buffer;
+        auto put = [&buffer](const void* p, size_t n) { buffer.append(static_cast<const char*>(p), n); };
+        ledger_header h{};
+        std::memcpy(h.magic, ledger_magic, sizeof(h.magic));
+        h.total = total;
+        h.covered = covered;
+        h.blocks = 0;
+        put(&h, sizeof(h));
+        for (auto& [key, b] : blocks) {
+            if (b.count == 0) continue;
+            h.blocks++;
+            auto runs = b.run_list();
+            block_form form = b.best_form(runs.size());
+            uint32_t n = form == block_form::runs ? uint32_t(runs.size())
+                       : form == block_form::array ? b.count : uint32_t(block::words);
+            put(&key, sizeof(key));
+            put(&form, sizeof(form));
+            put(&n, sizeof(n));
+            if (form == block_form::bitmap) {
+                if (b.dense()) {
+                    put(b.bits.data(), block::words * sizeof(uint64_t));
+                } else {
+                    block copy = b;
+                    copy.to_bitmap();
+                    put(copy.bits.data(), block::words * sizeof(uint64_t));
+                }
+            } else {
+                for (auto& r : runs) {
+                    if (form == block_form::runs) {
+                        uint16_t pair[2] = {uint16_t(r.first), uint16_t(r.second)};
+                        put(pair, sizeof(pair));
+                    } else {
+                        for (uint32_t x = r.first; x <= r.second; ++x) {
+                            uint16_t v = uint16_t(x);
+                            put(&v, sizeof(v));
+                        }
+                    }
+                }
+            }
+        }
+        std::memcpy(&buffer[offsetof(ledger_header, blocks)], &h.blocks, sizeof(h.blocks));
+
+        std::string tmp_name = file_name + ".tmp." + std::to_string(getpid());
+        int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::runtime_error("cannot create '" + tmp_name + "'");
+        size_t written = 0;
+        while (written < buffer.size()) {
+            ssize_t n = write(fd, buffer.data() + written, buffer.size() - written);
+            if (n <= 0) break;
+            written += size_t(n);
+        }
+        bool ok = written == buffer.size() && fsync(fd) == 0;
+        close(fd);
+        if (!ok || rename(tmp_name.c_str(), file_name.c_str()) != 0) {
+            unlink(tmp_name.c_str());
+            throw std::runtime_error("cannot write '" + file_name + "'");
+        }
+        // Make the rename itself durable
+        std::string dir = file_name.find('/') == std::string::npos ? "." : file_name.substr(0, file_name.rfind('/') + 1);
+        int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dir_fd >= 0) {
+            fsync(dir_fd);
+            close(dir_fd);
+        }
+    }
+};
+
+bool is_ledger_file(const std::string& file_name) {
+    std::ifstream in(file_name, std::ios::binary);
+    char magic[sizeof(ledger_magic)];
+    return in.read(magic, sizeof(magic)) && std::memcmp(magic, ledger_magic, sizeof(magic)) == 0;
+}
+
+// A worker report is either another ledger or text with one "begin end"
+// (half-open) or single range number per line; '#' starts a comment
+size_t add_report(coverage_ledger& ledger, const std::string& file_name) {
+    if (is_ledger_file(file_name)) {
+        coverage_ledger other;
+        other.load(file_name);
+        ledger.merge(other);
+        return other.block_count();
+    }
+    std::ifstream in(file_name);
+    if (!in) throw std::runtime_error("cannot open '" + file_name + "'");
+    size_t lines = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        uint64_t begin, end;
+        if (!(fields >> begin)) continue;
+        if (!(fields >> end)) end = begin + 1;
+        ledger.add(begin, end);
+        lines++;
+    }
+    return lines;
+}
+
+// Exclusive lock next to the ledger, held while it is read, updated and replaced
+class ledger_lock {
+private:
+    int fd;
+
+public:
+    explicit ledger_lock(const std::string& file_name) {
+        std::string lock_name = file_name + ".lock";
+        fd = open(lock_name.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0 || flock(fd, LOCK_EX) != 0) throw std::runtime_error("cannot lock '" + lock_name + "'");
+    }
+
+    ~ledger_lock() {
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+};
+
+int main(int argc, char* argv[]) {
+    uint64_t total = 0, from = 0;
+    std::vector<std::string> positional;
+
+    // Parse command line arguments: <ledger> <command> [args] [--total N] [--from N]
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--total" && has_value) {
+            total = std::stoull(argv[++i]);
+        } else if (arg == "--from" && has_value) {
+            from = std::stoull(argv[++i]);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() < 2) {
+        std::cout << "Usage: " << argv[0] << " <ledger> add <report>... [--total N]" << std::endl;
+        std::cout << "       " << argv[0] << " <ledger> next <count> [--from N]" << std::endl;
+        std::cout << "       " << argv[0] << " <ledger> stats" << std::endl;
+        std::cout << "       " << argv[0] << " <ledger> has <index>" << std::endl;
+        std::cout << "Reports are ledgers or text files of \"begin end\" (end exclusive) or single indices" << std::endl;
+        std::cout << "'next' prints uncovered ranges holding up to <count> indices, one \"begin end\" per line" << std::endl;
+        return 1;
+    }
+    const std::string& file_name = positional[0];
+    const std::string& command = positional[1];
+
+    try {
+        coverage_ledger ledger;
+        if (command == "add") {
+            ledger_lock lock(file_name);
+            if (access(file_name.c_str(), F_OK) == 0) ledger.load(file_name);
+            if (total > 0) ledger.total = total;
+            auto start_time = std::chrono::high_resolution_clock::now();
+            uint64_t before = ledger.covered;
+            for (size_t i = 2; i < positional.size(); ++i) add_report(ledger, positional[i]);
+            ledger.save(file_name);
+            auto end_time = std::chrono::high_resolution_clock::now();
+            std::cout << "Merged " << positional.size() - 2 << " reports: " << ledger.covered - before
+                      << " newly covered, " << ledger.covered << " in all, in "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms" << std::endl;
+            return 0;
+        }
+
+        if (command == "stats") {
+            // Only the header is read, however large the ledger
+            std::ifstream in(file_name, std::ios::binary);
+            if (!in) throw std::runtime_error("cannot open '" + file_name + "'");
+            ledger_header h = coverage_ledger::read_header(in, file_name);
+            if (total > 0) h.total = total;
+            std::cout << h.covered << " of " << h.total << " ranges covered ("
+                      << std::setprecision(6) << 100.0 * double(h.covered) / double(h.total) << "%) in "
+                      << h.blocks << " blocks" << std::endl;
+            return 0;
+        }
+
+        ledger.load(file_name);
+        if (total > 0) ledger.total = total;
+        if (command == "next" && positional.size() > 2) {
+            for (auto& [begin, end] : ledger.gaps(from, std::stoull(positional[2]))) {
+                std::cout << begin << " " << end << "\n";
+            }
+        } else if (command == "has" && positional.size() > 2) {
+            bool covered = ledger.contains(std::stoull(positional[2]));
+            std::cout << (covered ? "covered" : "not covered") << std::endl;
+            return covered ? 0 : 2;
+        } else {
+            std::cerr << "Error: unknown command '" << command << "'" << std::endl;
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,23 +1,51 @@
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <cstdint>
 #include <chrono>
+#include <cmath>
 #include <condition_variable>
+#include <deque>
+#include <execution>
 #include <future>
+#include <memory>
 #include <mutex>
+#include <numeric>
 #include <queue>
+#include <set>
 #include <random>
 #include <thread>
 #include <vector>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include <fstream>
 #include <functional>
+#include <unordered_map>
 #include <unordered_set>
+#include <linux/mempolicy.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string>
+
+struct position_bias;
 
 // Card representation: 0=non-face card, 1=J, 2=Q, 3=K, 4=A
+using card_t = uint8_t;
+
 struct deck {
     static constexpr int size = 52;
-    std::vector<int> cards;
+    std::array<card_t, size> cards;
 
-    deck() : cards(size, 0) {}
+    deck() : cards{} {}
 
     void shuffle(std::mt19937& rng) {
         std::fill(cards.begin(), cards.end(), 0);
@@ -33,6 +61,34 @@ struct deck {
         }
     }
 
+    // Same as shuffle() but face cards prefer positions with a high bias weight
+    void shuffle(std::mt19937& rng, const position_bias& bias);
+
+    // Swap `swaps` random pairs of different cards, keeping four of each face card
+    void mutate(std::mt19937& rng, int swaps) {
+        std::uniform_int_distribution<> pos(0, size - 1);
+        for (int i = 0; i < swaps; ++i) {
+            int a = pos(rng), b;
+            do {
+                b = pos(rng);
+            } while (cards[a] == cards[b]);
+            std::swap(cards[a], cards[b]);
+        }
+    }
+
+    // Check if the deck has exactly 4 of each face card
+    bool is_valid() const {
+        int counts[5] = {0}; // Index 0 for non-face cards, 1-4 for J,Q,K,A
+        for (int card : cards) {
+            if (card < 0 || card > 4) return false;
+            counts[card]++;
+        }
+        for (int i = 1; i <= 4; ++i) {
+            if (counts[i] != 4) return false;
+        }
+        return true;
+    }
+
     // Create a deck from a string representation
     static deck from_string(const std::string& str) {
         deck d;
@@ -64,270 +120,3356 @@ struct deck {
     }
 };
 
-struct player {
-    int id;
-    std::vector<int> cards;
+// Compact 128-bit key of a deal, used wherever results are stored or compared.
+// `hi` holds the face card mask with position 0 in the top bit (52 bits used),
+// `lo` holds the face values (rank - 1, 2 bits each) in position order from the
+// top bit (32 bits used). Comparing (hi, lo) as unsigned integers, or the bytes
+// in most-significant-first order, gives the same canonical ordering.
+struct DeckKey {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    static DeckKey from_deck(const deck& d) {
+        DeckKey k;
+        int faces = 0;
+        for (int i = 0; i < deck::size; ++i) {
+            int card = d.cards[i];
+            if (card > 0) {
+                // `lo` has room for the 16 face cards of a deal and no more
+                if (faces == 16) throw std::invalid_argument("deck has more than 16 face cards");
+                k.hi |= uint64_t(1) << (63 - i);
+                k.lo |= uint64_t(card - 1) << (62 - 2 * faces++);
+            }
+        }
+        return k;
+    }
+
+    deck to_deck() const {
+        deck d;
+        uint64_t mask = hi;
+        for (int faces = 0; mask != 0; ++faces) {
+            int pos = __builtin_clzll(mask);
+            mask &= ~(uint64_t(1) << (63 - pos));
+            d.cards[pos] = int((lo >> (62 - 2 * faces)) & 3) + 1;
+        }
+        return d;
+    }
+
+    // Byte `i` of the key in sort order, for radix sorts (0 <= i < 16)
+    uint8_t byte(int i) const {
+        return i < 8 ? uint8_t(hi >> (56 - 8 * i)) : uint8_t(lo >> (120 - 8 * i));
+    }
+
+    bool operator==(const DeckKey& o) const { return hi == o.hi && lo == o.lo; }
+    bool operator!=(const DeckKey& o) const { return !(*this == o); }
+    bool operator<(const DeckKey& o) const { return hi != o.hi ? hi < o.hi : lo < o.lo; }
 
-    player(int id) : id(id) {}
+    friend std::ostream& operator<<(std::ostream& os, const DeckKey& k) {
+        return os << k.to_deck();
+    }
 };
 
-// Thread pool for managing worker threads
-class ThreadPool {
-private:
-    std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
-    std::mutex queue_mutex;
-    std::condition_variable condition;
-    bool stop;
+namespace std {
+template<> struct hash<DeckKey> {
+    size_t operator()(const DeckKey& k) const {
+        uint64_t h = k.hi * 0x9e3779b97f4a7c15ULL ^ k.lo;
+        h ^= h >> 32;
+        h *= 0xd6e8feb86659fd93ULL;
+        h ^= h >> 32;
+        return size_t(h);
+    }
+};
+}
 
-public:
-    ThreadPool(size_t num_threads) : stop(false) {
-        workers.reserve(num_threads);
-        for (size_t i = 0; i < num_threads; ++i) {
-            workers.emplace_back([this] {
-                while (true) {
-                    std::function<void()> task;
-                    {
-                        std::unique_lock<std::mutex> lock(queue_mutex);
-                        condition.wait(lock, [this] { return stop || !tasks.empty(); });
-                        if (stop && tasks.empty()) return;
-                        task = std::move(tasks.front());
-                        tasks.pop();
-                    }
-                    task();
-                }
-            });
+// Sampling weights for a biased shuffle, in (0, 1] per face card and position
+struct position_bias {
+    double weight[5][deck::size];
+};
+
+void deck::shuffle(std::mt19937& rng, const position_bias& bias) {
+    std::fill(cards.begin(), cards.end(), 0);
+    std::uniform_real_distribution<> unit(0.0, 1.0);
+    // Place face cards (4 of each type), rejecting positions by their weight
+    for (int card = 1; card <= 4; ++card) {
+        for (int iter = 0; iter < 4; ++iter) {
+            int pos;
+            do {
+                pos = std::uniform_int_distribution<>(0, size - 1)(rng);
+            } while (cards[pos] != 0 || unit(rng) > bias.weight[card][pos]);
+            cards[pos] = card;
         }
     }
+}
 
-    ~ThreadPool() {
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            stop = true;
+// Game length statistics against positional features of the deal: the card at
+// each position, and the spacing between consecutive face cards. Positions
+// count from the top of the leading player's hand, so 26..51 is the other hand.
+// Accumulators are mergeable by adding them up.
+struct feature_stats {
+    struct moments {
+        double n = 0, sum = 0, sum_sq = 0;
+
+        void add(double x) {
+            n += 1;
+            sum += x;
+            sum_sq += x * x;
         }
-        condition.notify_all();
-        for (auto& worker : workers) {
-            if (worker.joinable()) {
-                worker.join();
+
+        void merge(const moments& o) {
+            n += o.n;
+            sum += o.sum;
+            sum_sq += o.sum_sq;
+        }
+
+        double mean() const { return n > 0 ? sum / n : 0; }
+        double stddev() const { return n > 1 ? std::sqrt(std::max(0.0, sum_sq / n - mean() * mean())) : 0; }
+    };
+
+    moments all;
+    moments position[deck::size][5];
+    moments gap[deck::size];
+
+    // `rotate` is true when the second half of the deck led the game
+    void add(const DeckKey& key, int cards_played, bool rotate) {
+        double x = cards_played;
+        all.add(x);
+        int faces = 0, last_face = -1;
+        for (int i = 0; i < deck::size; ++i) {
+            int card = 0;
+            if ((key.hi >> (63 - i)) & 1) {
+                card = int((key.lo >> (62 - 2 * faces++)) & 3) + 1;
+                if (last_face >= 0) gap[i - last_face].add(x);
+                last_face = i;
             }
+            position[rotate ? (i + deck::size / 2) % deck::size : i][card].add(x);
         }
     }
 
-    template<typename F, typename... Args>
-    auto enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result<F, Args...>::type> {
-        using return_type = typename std::invoke_result<F, Args...>::type;
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-        );
-        std::future<return_type> res = task->get_future();
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            tasks.emplace([task]() { (*task)(); });
+    void merge(const feature_stats& o) {
+        all.merge(o.all);
+        for (int i = 0; i < deck::size; ++i) {
+            for (int c = 0; c < 5; ++c) position[i][c].merge(o.position[i][c]);
+            gap[i].merge(o.gap[i]);
+        }
+    }
+
+    // Weight face card positions by how far their mean game length lies above the
+    // overall mean, in standard deviations, shrunk towards zero for thin cells
+    position_bias bias(double strength) const {
+        position_bias b;
+        double sd = std::max(all.stddev(), 1.0);
+        for (int c = 0; c < 5; ++c) {
+            double top = 0;
+            for (int i = 0; i < deck::size; ++i) {
+                const moments& m = position[i][c];
+                double z = m.n > 0 ? (m.mean() - all.mean()) / sd * m.n / (m.n + 100) : 0;
+                b.weight[c][i] = std::exp(strength * z);
+                top = std::max(top, b.weight[c][i]);
+            }
+            for (int i = 0; i < deck::size; ++i) b.weight[c][i] /= top;
+        }
+        return b;
+    }
+
+    void dump(std::ostream& os) const {
+        static const char names[] = "-JQKA";
+        os << "# games," << all.n << ",mean_length," << all.mean() << ",stddev," << all.stddev() << "\n";
+        os << "# position,player,card,games,mean_length,stddev\n";
+        for (int i = 0; i < deck::size; ++i) {
+            for (int c = 0; c < 5; ++c) {
+                const moments& m = position[i][c];
+                os << i << "," << (i < deck::size / 2 ? 1 : 2) << "," << names[c] << ","
+                   << m.n << "," << m.mean() << "," << m.stddev() << "\n";
+            }
+        }
+        os << "# face_card_gap,games,mean_length,stddev\n";
+        for (int g = 1; g < deck::size; ++g) {
+            if (gap[g].n > 0) os << g << "," << gap[g].n << "," << gap[g].mean() << "," << gap[g].stddev() << "\n";
         }
-        condition.notify_one();
-        return res;
     }
 };
 
-// Game state hash for cycle detection
-struct GameStateHash {
-    std::size_t operator()(const std::pair<std::vector<int>, std::vector<int>>& state) const {
-        std::size_t seed = state.first.size();
-        for (auto& i : state.first) {
-            seed ^= i + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+// One accumulator per worker thread. Each worker only locks its own slot,
+// which is uncontended except for the moment a merge reads it.
+template <class T>
+class per_thread_slots {
+public:
+    struct slot {
+        std::mutex mutex;
+        T value;
+        long games = 0; // games the worker has played, for collectors that sample
+    };
+
+private:
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<slot>> slots;
+
+public:
+    slot& local() {
+        thread_local std::pair<const per_thread_slots*, slot*> mine{nullptr, nullptr};
+        if (mine.first != this) {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            slots.emplace_back(new slot);
+            mine = {this, slots.back().get()};
         }
-        for (auto& i : state.second) {
-            seed ^= i + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        return *mine.second;
+    }
+
+    // Sum of all slots, for accumulators with merge()
+    std::unique_ptr<T> merged() {
+        std::unique_ptr<T> total(new T);
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (auto& s : slots) {
+            std::lock_guard<std::mutex> slot_lock(s->mutex);
+            total->merge(s->value);
         }
-        return seed;
+        return total;
     }
 };
 
-class game {
+// Per-worker feature_stats. Optionally turns the merged statistics into a live
+// position_bias that new deals are drawn with.
+class feature_collector {
 private:
-    deck d;
-    player p1;
-    player p2;
-    std::mt19937 rng;
-    
-    int cards_played_total = 0;
-    int tricks = 0;
-    std::vector<int> pile;
-    int remaining_penalties = 0;
-    bool face_card_active = false;
-    player* active_player;
-    int max_moves = 10000; // Limit to prevent infinite games
-    
-    // For cycle detection
-    std::unordered_set<std::pair<std::vector<int>, std::vector<int>>, GameStateHash> seen_states;
+    per_thread_slots<feature_stats> slots;
+    std::shared_ptr<const position_bias> bias;
 
 public:
-    game() : p1(1), p2(2), rng(std::random_device{}()) {}
+    void add(const DeckKey& key, int cards_played, int start_player) {
+        auto& s = slots.local();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.value.add(key, cards_played, start_player == 2);
+    }
 
-    void start() {
-        d.shuffle(rng);
-        split_cards();
-        active_player = &p1;
-        cards_played_total = 0;
-        tricks = 0;
-        pile.clear();
-        remaining_penalties = 0;
-        face_card_active = false;
-        seen_states.clear();
+    std::unique_ptr<feature_stats> merged() {
+        return slots.merged();
     }
 
-    void split_cards() {
-        auto mid = d.cards.size() / 2;
-        p1.cards = std::vector<int>(d.cards.begin(), d.cards.begin() + mid);
-        p2.cards = std::vector<int>(d.cards.begin() + mid, d.cards.end());
+    // Publish a new bias from everything collected so far
+    void refresh_bias(double strength) {
+        auto next = std::make_shared<const position_bias>(merged()->bias(strength));
+        std::atomic_store(&bias, next);
     }
 
-    std::tuple<int, int, int, deck> play() {
-        while (!is_game_over() && cards_played_total < max_moves) {
-            // Check for cycles (same cards in same order for both players)
-            auto state = std::make_pair(p1.cards, p2.cards);
-            if (seen_states.count(state) > 0) {
-                // We've seen this exact state before - it's a cycle
-                return {-1, cards_played_total, tricks, d};
-            }
-            seen_states.insert(state);
-            
-            turn();
+    // Bias to draw the next deal with, or null while no bias is published
+    std::shared_ptr<const position_bias> current_bias() const {
+        return std::atomic_load(&bias);
+    }
+};
+
+// Distributions of the game's internal dynamics, for sizing buffers and tables
+// from data: pile size at each pickup, penalty chain length (face cards in a
+// trick), hand sizes at trick boundaries and over the game, and tricks against
+// game length. Every histogram is a plain count array, so profiles merge by
+// addition.
+struct dynamics_profile {
+    static constexpr int max_chain = 16;
+    static constexpr int move_buckets = 101;   // 100 moves each, the last one open
+    static constexpr int trick_buckets = 51;   // 10 tricks each, the last one open
+
+    struct length_row {
+        uint64_t games = 0, tricks_sum = 0;
+        int tricks_min = 0, tricks_max = 0;
+    };
+    struct trajectory_row {
+        uint64_t tricks = 0, short_sum = 0;
+        int short_min = deck::size, short_max = 0;
+    };
+
+    uint64_t pile[deck::size + 1] = {};
+    uint64_t chain[max_chain + 1] = {};
+    uint64_t short_hand[deck::size + 1] = {}; // smaller hand after each pickup
+    uint64_t peak_hand[deck::size + 1] = {};  // largest hand of each game
+    length_row by_moves[move_buckets];
+    trajectory_row by_trick[trick_buckets];
+    uint64_t games = 0, cycles = 0, unfinished = 0;
+    int game_tricks = 0, game_peak = deck::size / 2;
+
+    void on_trick(size_t pile_size, int faces, size_t hand1, size_t hand2) {
+        pile[std::min<size_t>(pile_size, deck::size)]++;
+        chain[std::min(faces, max_chain)]++;
+        int small = int(std::min(hand1, hand2)), large = int(std::max(hand1, hand2));
+        short_hand[small]++;
+        game_peak = std::max(game_peak, large);
+        trajectory_row& row = by_trick[std::min(game_tricks / 10, trick_buckets - 1)];
+        row.tricks++;
+        row.short_sum += small;
+        row.short_min = std::min(row.short_min, small);
+        row.short_max = std::max(row.short_max, small);
+        game_tricks++;
+    }
+
+    // `winner` is -1 for a cycle and 0 for a game stopped at the move limit
+    void on_game(int winner, int moves, int tricks) {
+        games++;
+        if (winner < 0) {
+            cycles++;
+        } else if (winner == 0) {
+            unfinished++;
+        } else {
+            length_row& row = by_moves[std::min(moves / 100, move_buckets - 1)];
+            row.tricks_min = row.games == 0 ? tricks : std::min(row.tricks_min, tricks);
+            row.tricks_max = std::max(row.tricks_max, tricks);
+            row.games++;
+            row.tricks_sum += tricks;
         }
-        
-        return {
-            active_player->id, 
-            cards_played_total, 
-            tricks,
-            d  // Return the deck that was used for this game
-        };
+        peak_hand[std::min(game_peak, deck::size)]++;
+        game_tricks = 0;
+        game_peak = deck::size / 2;
     }
 
-    bool is_game_over() const {
-        return p1.cards.empty() || p2.cards.empty();
+    void merge(const dynamics_profile& o) {
+        for (int i = 0; i <= deck::size; ++i) {
+            pile[i] += o.pile[i];
+            short_hand[i] += o.short_hand[i];
+            peak_hand[i] += o.peak_hand[i];
+        }
+        for (int i = 0; i <= max_chain; ++i) chain[i] += o.chain[i];
+        for (int i = 0; i < move_buckets; ++i) {
+            length_row& r = by_moves[i];
+            const length_row& s = o.by_moves[i];
+            if (s.games == 0) continue;
+            r.tricks_min = r.games == 0 ? s.tricks_min : std::min(r.tricks_min, s.tricks_min);
+            r.tricks_max = std::max(r.tricks_max, s.tricks_max);
+            r.games += s.games;
+            r.tricks_sum += s.tricks_sum;
+        }
+        for (int i = 0; i < trick_buckets; ++i) {
+            trajectory_row& r = by_trick[i];
+            const trajectory_row& s = o.by_trick[i];
+            r.tricks += s.tricks;
+            r.short_sum += s.short_sum;
+            r.short_min = std::min(r.short_min, s.short_min);
+            r.short_max = std::max(r.short_max, s.short_max);
+        }
+        games += o.games;
+        cycles += o.cycles;
+        unfinished += o.unfinished;
     }
 
-    void turn() {
-        if (active_player->cards.empty()) {
-            return;
+    // Count, share and cumulative share of every non-empty histogram bucket
+    static void print_histogram(std::ostream& os, const char* title, const uint64_t* counts, int n) {
+        uint64_t total = 0;
+        for (int i = 0; i < n; ++i) total += counts[i];
+        os << "# " << title << ",count,share,cumulative\n";
+        uint64_t running = 0;
+        for (int i = 0; i < n; ++i) {
+            if (counts[i] == 0) continue;
+            running += counts[i];
+            os << i << "," << counts[i] << "," << double(counts[i]) / total << "," << double(running) / total << "\n";
         }
+    }
 
-        int card = active_player->cards.front();
-        active_player->cards.erase(active_player->cards.begin());
-        pile.push_back(card);
-        cards_played_total++;
-        
-        if (card > 0) { // Face card played
-            face_card_active = true;
-            remaining_penalties = card;
-            switch_player();
-        } else if (face_card_active) {
-            remaining_penalties--;
-            if (remaining_penalties == 0) {
-                // Trick completed, current player takes all cards
-                tricks++;
-                face_card_active = false;
-                
-                // Add cards to the back of player's hand
-                active_player->cards.insert(
-                    active_player->cards.end(),
-                    pile.begin(),
-                    pile.end()
-                );
-                pile.clear();
-            } else {
-                switch_player();
-            }
-        } else {
-            switch_player();
+    void print(std::ostream& os) const {
+        os << "# games," << games << ",cycles," << cycles << ",unfinished," << unfinished << "\n";
+        print_histogram(os, "pile_at_pickup", pile, deck::size + 1);
+        print_histogram(os, "penalty_chain", chain, max_chain + 1);
+        print_histogram(os, "short_hand_at_trick", short_hand, deck::size + 1);
+        print_histogram(os, "peak_hand_per_game", peak_hand, deck::size + 1);
+        os << "# tricks_from,tricks,mean_short_hand,min,max\n";
+        for (int i = 0; i < trick_buckets; ++i) {
+            const trajectory_row& r = by_trick[i];
+            if (r.tricks == 0) continue;
+            os << i * 10 << "," << r.tricks << "," << double(r.short_sum) / r.tricks << ","
+               << r.short_min << "," << r.short_max << "\n";
+        }
+        os << "# moves_from,games,mean_tricks,min,max,moves_per_trick\n";
+        for (int i = 0; i < move_buckets; ++i) {
+            const length_row& r = by_moves[i];
+            if (r.games == 0) continue;
+            double mean = double(r.tricks_sum) / r.games;
+            os << i * 100 << "," << r.games << "," << mean << "," << r.tricks_min << "," << r.tricks_max << ","
+               << (i * 100 + 50) / std::max(mean, 1.0) << "\n";
+        }
+    }
+};
+
+// Per-worker dynamics_profile. Only every `sample_every`-th game of a worker is
+// profiled; the others run without hooks, which bounds the overhead of profiling.
+class dynamics_collector {
+private:
+    per_thread_slots<dynamics_profile> slots;
+    long sample_every;
+
+public:
+    explicit dynamics_collector(long sample_every) : sample_every(std::max(1L, sample_every)) {}
+
+    // Runs play(dynamics_profile*) with this worker's profile if the game is
+    // sampled, and with null otherwise
+    template <class F>
+    auto sample(F play) {
+        auto& s = slots.local();
+        if (s.games++ % sample_every != 0) {
+            return play(nullptr);
         }
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return play(&s.value);
     }
 
-    void switch_player() {
-        active_player = (active_player == &p1) ? &p2 : &p1;
+    std::unique_ptr<dynamics_profile> merged() {
+        return slots.merged();
     }
 };
 
-// Function to run a single game simulation
-std::tuple<int, int, int, deck> run_game_simulation() {
-    game g;
-    g.start();
-    return g.play();
+// Page size policy for large shared tables
+enum class page_mode { normal, transparent, huge_2m, huge_1g };
+
+const char* page_mode_name(page_mode mode) {
+    switch (mode) {
+        case page_mode::huge_1g: return "1 GB huge pages";
+        case page_mode::huge_2m: return "2 MB huge pages";
+        case page_mode::transparent: return "transparent huge pages";
+        default: return "4 KB pages";
+    }
 }
 
-int main(int argc, char* argv[]) {
-    long num_games = 100000;
-    int num_threads = std::thread::hardware_concurrency();
-    int high_score = 0;
-    
-    // Parse command line arguments
-    if (argc > 1) {
-        num_games = std::stoi(argv[1]);
+// Anonymous memory for large shared tables (dedup filters, visited sets, caches).
+// Tries explicit huge pages first and falls back one step at a time down to
+// normal pages: 1 GB -> 2 MB -> madvise(MADV_HUGEPAGE) -> 4 KB. A page size is
+// also skipped if rounding up to it would map more than `limit`. Memory can be
+// interleaved across NUMA nodes, and is pre-faulted so that page faults happen
+// at startup rather than in the middle of the search.
+class large_table_memory {
+private:
+    void* base = nullptr;
+    size_t bytes = 0;
+    size_t mapped = 0;
+    page_mode used = page_mode::normal;
+
+    static constexpr size_t huge_2m = size_t(1) << 21;
+    static constexpr size_t huge_1g = size_t(1) << 30;
+
+    static size_t round_up(size_t n, size_t to) {
+        return (n + to - 1) / to * to;
     }
-    if (argc > 2) {
-        num_threads = std::stoi(argv[2]);
+
+    bool map_explicit(size_t page, int flag) {
+        size_t len = round_up(bytes, page);
+        void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | flag, -1, 0);
+        if (p == MAP_FAILED) return false;
+        base = p;
+        mapped = len;
+        return true;
     }
-    if (argc > 3) {
-        high_score = std::stoi(argv[3]);
+
+    bool map_normal(bool advise) {
+        size_t len = round_up(bytes, advise ? huge_2m : 4096);
+        void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return false;
+        base = p;
+        mapped = len;
+        return !advise || madvise(p, len, MADV_HUGEPAGE) == 0;
     }
-    
-    std::cout << "Running " << num_games << " games with " << num_threads << " threads\n";
-    
-    std::ofstream file("high_score.txt", std::ios_base::app);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file 'high_score.txt'" << std::endl;
-        return 1;
+
+    // Mask of the online NUMA nodes, from a list like "0-3,5" in sysfs
+    static std::vector<unsigned long> online_nodes() {
+        constexpr int bits = 8 * sizeof(unsigned long);
+        std::vector<unsigned long> mask;
+        std::ifstream in("/sys/devices/system/node/online");
+        std::string list, range;
+        std::getline(in, list);
+        std::stringstream ranges(list);
+        while (std::getline(ranges, range, ',')) {
+            size_t dash = range.find('-');
+            try {
+                int first = std::stoi(range.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int node = first; node <= last; ++node) {
+                    if (size_t(node / bits) >= mask.size()) mask.resize(node / bits + 1, 0);
+                    mask[node / bits] |= 1UL << (node % bits);
+                }
+            } catch (const std::exception&) {
+            }
+        }
+        if (mask.empty()) mask.push_back(1); // no sysfs: node 0 only
+        return mask;
     }
 
-    ThreadPool pool(num_threads);
+public:
+    large_table_memory(size_t bytes, size_t limit, page_mode want, bool numa_interleave, int prefault_threads)
+        : bytes(bytes) {
+        auto fits = [bytes, limit](size_t page) { return round_up(bytes, page) <= limit; };
+        if (want == page_mode::huge_1g && fits(huge_1g) && map_explicit(huge_1g, 30 << MAP_HUGE_SHIFT)) {
+            used = page_mode::huge_1g;
+        } else if (want >= page_mode::huge_2m && fits(huge_2m) && map_explicit(huge_2m, 21 << MAP_HUGE_SHIFT)) {
+            used = page_mode::huge_2m;
+        } else if (want >= page_mode::transparent && fits(huge_2m) && map_normal(true)) {
+            used = page_mode::transparent;
+        } else if (base || map_normal(false)) {
+            used = page_mode::normal;
+        } else {
+            throw std::bad_alloc();
+        }
 
-    int games_completed = 0;
-    auto start_time = std::chrono::high_resolution_clock::now();
+        if (numa_interleave) {
+            // Interleave over the online nodes. A mask wider than the kernel's
+            // node limit is only accepted if the extra bits are clear, so it
+            // holds no more nodes than are online. The kernel reads one bit
+            // less than max_node.
+            std::vector<unsigned long> nodes = online_nodes();
+            unsigned long max_node = nodes.size() * 8 * sizeof(unsigned long) + 1;
+            if (syscall(SYS_mbind, base, mapped, MPOL_INTERLEAVE, nodes.data(), max_node, 0) != 0) {
+                std::cerr << "Warning: NUMA interleave not available for large table" << std::endl;
+            }
+        }
 
-    std::vector<std::future<std::tuple<int, int, int, deck>>> results;
-    results.reserve(num_games);
+        // Pre-fault by touching every page from several threads
+        size_t page = used == page_mode::huge_1g ? huge_1g : used == page_mode::normal ? 4096 : huge_2m;
+        size_t pages = mapped / page;
+        std::vector<std::thread> threads;
+        int n = std::max(1, std::min<int>(prefault_threads, int(pages)));
+        for (int t = 0; t < n; ++t) {
+            threads.emplace_back([this, t, n, page, pages] {
+                for (size_t i = pages * t / n; i < pages * (t + 1) / n; ++i) {
+                    static_cast<volatile char*>(base)[i * page] = 0;
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+    }
 
-    // Start all game simulations
-    for (long i = 0; i < num_games; ++i) {
-        results.push_back(pool.enqueue(run_game_simulation));
+    ~large_table_memory() {
+        if (base) munmap(base, mapped);
     }
 
-    // Collect results
-    for (auto& result : results) {
-        try {
-            auto [winner, cards_played, tricks, game_deck] = result.get();
-            games_completed++;
-            
-            // Only record valid games (not cycles)
-            if (winner > 0 && cards_played > high_score) {
-                high_score = cards_played;
-                
-                std::cout << "New high score: " << high_score 
-                          << " cards, " << tricks << " tricks, winner: Player " 
-                          << winner << std::endl;
-                
-                file << high_score << "," << tricks << "," << winner << "," << game_deck << "\n";
-                file.flush();
-            }
-            
-            // Progress update
-            if (games_completed % 10000 == 0) {
-                auto now = std::chrono::high_resolution_clock::now();
-                auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
-                std::cout << "Completed " << games_completed << " games. "
-                          << "Games per second: " << (games_completed / (duration + 0.1)) << std::endl;
+    large_table_memory(const large_table_memory&) = delete;
+    large_table_memory& operator=(const large_table_memory&) = delete;
+
+    void* data() const { return base; }
+    size_t size() const { return bytes; }
+    size_t mapped_bytes() const { return mapped; }
+    page_mode mode() const { return used; }
+};
+
+// One memory budget shared by the caches that can grow large. Each cache
+// registers with a weight before anything is allocated; distribute() then
+// grants every one a share of the total in proportion to its weight, and the
+// cache sizes itself to that share and evicts when it is full. Without a
+// total every grant is 0, meaning the cache uses its own default size.
+class memory_budget {
+public:
+    struct component {
+        std::string name;
+        double weight;
+        size_t granted = 0;
+        std::atomic<size_t> used{0};
+        std::atomic<size_t> peak{0};
+
+        component(std::string name, double weight) : name(std::move(name)), weight(weight) {}
+
+        void set_used(size_t bytes) {
+            used = bytes;
+            size_t p = peak.load();
+            while (bytes > p && !peak.compare_exchange_weak(p, bytes)) {}
+        }
+    };
+
+private:
+    size_t total;
+    std::deque<component> components; // stable addresses
+
+public:
+    explicit memory_budget(size_t total) : total(total) {}
+
+    component* add(const std::string& name, double weight) {
+        components.emplace_back(name, weight);
+        return &components.back();
+    }
+
+    void distribute() {
+        double weights = 0;
+        for (auto& c : components) weights += c.weight;
+        for (auto& c : components) {
+            c.granted = total > 0 && weights > 0 ? size_t(double(total) * c.weight / weights) : 0;
+        }
+    }
+
+    size_t limit() const { return total; }
+
+    // Resident set size of the whole process
+    static size_t resident_bytes() {
+        std::ifstream statm("/proc/self/statm");
+        size_t pages = 0, resident = 0;
+        statm >> pages >> resident;
+        return resident * size_t(sysconf(_SC_PAGESIZE));
+    }
+
+    static std::string format_bytes(size_t bytes) {
+        return bytes >= (size_t(10) << 20) ? std::to_string(bytes >> 20) + " MB" : std::to_string(bytes >> 10) + " KB";
+    }
+
+    // RSS, then current and peak use of every component against its grant
+    void report(std::ostream& os) const {
+        os << "Memory: RSS " << format_bytes(resident_bytes());
+        if (total > 0) {
+            os << ", budget " << format_bytes(total);
+        }
+        for (auto& c : components) {
+            os << "; " << c.name << " " << format_bytes(c.used.load()) << " (peak " << format_bytes(c.peak.load()) << ")";
+            if (c.granted > 0) {
+                os << " of " << format_bytes(c.granted);
             }
-        } catch (const std::exception& e) {
-            std::cerr << "Error in game simulation: " << e.what() << std::endl;
         }
+        os << std::endl;
     }
+};
 
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time).count();
-    
-    std::cout << "Completed " << games_completed << " games in " << duration << " seconds" << std::endl;
-    std::cout << "Games per second: " << (games_completed / (duration + 0.1)) << std::endl;
-    std::cout << "Highest score: " << high_score << std::endl;
+// Lock-free set of deals seen recently, on large_table_memory. Each slot holds
+// a 56-bit fingerprint of a DeckKey and the 8-bit epoch in which it was last
+// seen; the epoch advances every capacity/4 inserts. Probing is linear over a
+// short window. When the window has no free slot, the least recently seen
+// entry in it is replaced, so a full table keeps recent deals instead of
+// refusing new ones. A false "seen" answer needs a fingerprint collision.
+class dedup_filter {
+private:
+    static constexpr int probe_window = 32;
+    static constexpr uint64_t fingerprint_mask = (uint64_t(1) << 56) - 1;
+
+    large_table_memory memory;
+    std::atomic<uint64_t>* slots;
+    size_t mask;
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> inserts{0};
+    std::atomic<size_t> evictions{0};
+    std::atomic<uint32_t> epoch{0};
+
+    static size_t capacity_for(size_t bytes) {
+        size_t capacity = 1024;
+        while (capacity * 2 * sizeof(uint64_t) <= bytes) capacity *= 2;
+        return capacity;
+    }
+
+    uint64_t stamp(uint64_t fp) const {
+        return fp | uint64_t(epoch.load(std::memory_order_relaxed) & 0xff) << 56;
+    }
+
+    // Epochs since the slot was last seen
+    uint32_t age(uint64_t slot) const {
+        return (epoch.load(std::memory_order_relaxed) - uint32_t(slot >> 56)) & 0xff;
+    }
+
+    void count_insert() {
+        if ((inserts.fetch_add(1, std::memory_order_relaxed) + 1) % ((mask + 1) / 4) == 0) {
+            epoch.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+public:
+    dedup_filter(size_t bytes, page_mode pages, bool numa_interleave, int prefault_threads)
+        : memory(capacity_for(bytes) * sizeof(uint64_t), bytes, pages, numa_interleave, prefault_threads) {
+        // Fresh anonymous pages are zero, which is the empty slot
+        slots = static_cast<std::atomic<uint64_t>*>(memory.data());
+        mask = capacity_for(bytes) - 1;
+    }
+
+    static uint64_t fingerprint(const DeckKey& key) {
+        return (uint64_t(std::hash<DeckKey>()(key)) & fingerprint_mask) | 1;
+    }
+
+    // Returns true if the deal was not seen recently (and is now recorded)
+    bool insert(const DeckKey& key) {
+        uint64_t fp = fingerprint(key);
+        size_t victim = fp & mask;
+        uint64_t victim_slot = 0;
+        for (int n = 0; n < probe_window; ++n) {
+            size_t i = (fp + n) & mask;
+            uint64_t cur = slots[i].load(std::memory_order_relaxed);
+            if ((cur & fingerprint_mask) == fp) {
+                if (age(cur) > 0) slots[i].compare_exchange_strong(cur, stamp(fp), std::memory_order_relaxed);
+                return false;
+            }
+            if (cur == 0) {
+                if (slots[i].compare_exchange_strong(cur, stamp(fp), std::memory_order_relaxed)) {
+                    count.fetch_add(1, std::memory_order_relaxed);
+                    count_insert();
+                    return true;
+                }
+                if ((cur & fingerprint_mask) == fp) return false;
+            }
+            if (n == 0 || age(cur) > age(victim_slot)) {
+                victim = i;
+                victim_slot = cur;
+            }
+        }
+        // Window full: replace its oldest entry. Losing the race only means
+        // this deal is not recorded.
+        if (slots[victim].compare_exchange_strong(victim_slot, stamp(fp), std::memory_order_relaxed)) {
+            evictions.fetch_add(1, std::memory_order_relaxed);
+            count_insert();
+        }
+        return true;
+    }
+
+    bool contains(const DeckKey& key) const {
+        uint64_t fp = fingerprint(key);
+        for (int n = 0; n < probe_window; ++n) {
+            uint64_t cur = slots[(fp + n) & mask].load(std::memory_order_relaxed);
+            if ((cur & fingerprint_mask) == fp) return true;
+            if (cur == 0) return false;
+        }
+        return false;
+    }
+
+    size_t size() const { return count.load(); }
+    size_t evicted() const { return evictions.load(); }
+    size_t capacity() const { return mask + 1; }
+    size_t bytes() const { return memory.mapped_bytes(); }
+    page_mode pages() const { return memory.mode(); }
+};
+
+// Read-only view of an endgame tablebase written by the tablebase tool. At a
+// trick boundary where one hand holds at most k cards and the other more than
+// m, the entry for the small hand and the first m cards of the big hand gives
+// the remaining cards and tricks if the game ends within that window.
+class endgame_tablebase {
+private:
+    struct header {
+        char magic[8];
+        uint32_t max_small;
+        uint32_t window;
+        uint64_t entries;
+        uint64_t chunks;
+    };
+    static constexpr uint64_t data_offset = 1 << 16;
+    static constexpr uint32_t resolved_bit = 1u << 31;
+
+    void* base = nullptr;
+    size_t length = 0;
+    const uint32_t* entries = nullptr;
+    size_t max_small = 0;
+    size_t window = 0;
+    uint64_t small_base[64] = {};
+    uint64_t prefixes = 1;
+
+public:
+    explicit endgame_tablebase(const std::string& name) {
+        int fd = open(name.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("cannot open tablebase " + name);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < data_offset) {
+            close(fd);
+            throw std::runtime_error("not a tablebase: " + name);
+        }
+        length = size_t(st.st_size);
+        base = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) throw std::runtime_error("cannot map tablebase " + name);
+
+        const header* h = static_cast<const header*>(base);
+        static const char magic[8] = {'B', 'M', 'N', 'T', 'B', '1', 0, 0};
+        if (!std::equal(magic, magic + 8, h->magic) || h->max_small >= 63 ||
+            data_offset + h->entries * sizeof(uint32_t) > length) {
+            munmap(base, length);
+            throw std::runtime_error("not a tablebase: " + name);
+        }
+        max_small = h->max_small;
+        window = h->window;
+        entries = reinterpret_cast<const uint32_t*>(static_cast<const char*>(base) + data_offset);
+        for (size_t i = 0; i < window; ++i) prefixes *= 5;
+        for (size_t s = 2, p = 5; s <= max_small; ++s, p *= 5) small_base[s] = small_base[s - 1] + p;
+    }
+
+    ~endgame_tablebase() {
+        munmap(base, length);
+    }
+
+    endgame_tablebase(const endgame_tablebase&) = delete;
+    endgame_tablebase& operator=(const endgame_tablebase&) = delete;
+
+    size_t small_limit() const { return max_small; }
+    size_t window_size() const { return window; }
+    size_t bytes() const { return length; }
+
+    // Look up a position; returns false if it is not covered or not resolved
+    template <class Hand>
+    bool probe(const Hand& small, const Hand& big, bool small_moves,
+               int& remaining_cards, int& remaining_tricks) const {
+        if (small.empty() || size_t(small.size()) > max_small || size_t(big.size()) <= window) return false;
+        uint64_t small_code = 0, big_code = 0;
+        for (int i = 0; i < int(small.size()); ++i) small_code = small_code * 5 + uint64_t(small[i]);
+        for (size_t i = 0; i < window; ++i) big_code = big_code * 5 + uint64_t(big[int(i)]);
+        uint64_t index = ((small_base[small.size()] + small_code) * prefixes + big_code) * 2 + (small_moves ? 0 : 1);
+        uint32_t e = entries[index];
+        if (!(e & resolved_bit)) return false;
+        remaining_cards = int(e & 0xffff);
+        remaining_tricks = int((e >> 16) & 0xff);
+        return true;
+    }
+};
+
+// Tablebase probed by every game, if one was loaded
+const endgame_tablebase* endgame_table = nullptr;
+
+// A hand in one cache line: the cards are a ring buffer that starts at `head`.
+// No hand can hold more than the deck, so nothing is ever allocated.
+struct alignas(64) player {
+    card_t cards[deck::size];
+    uint8_t head = 0;
+    uint8_t count = 0;
+    uint8_t face_cards = 0;
+    uint8_t id;
+
+    explicit player(int id) : id(uint8_t(id)) {}
+
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    card_t front() const { return cards[head]; }
+
+    // i-th card from the front
+    card_t& operator[](int i) {
+        int at = head + i;
+        return cards[at < deck::size ? at : at - deck::size];
+    }
+    card_t operator[](int i) const { return const_cast<player&>(*this)[i]; }
+
+    void pop_front() {
+        head = uint8_t(head + 1 == deck::size ? 0 : head + 1);
+        count--;
+    }
+    void drop_front(int n) {
+        head = uint8_t((head + n) % deck::size);
+        count = uint8_t(count - n);
+    }
+    void clear() {
+        head = count = 0;
+    }
+
+    void assign(const card_t* begin, int n) {
+        std::copy(begin, begin + n, cards);
+        head = 0;
+        count = uint8_t(n);
+        face_cards = uint8_t(std::count_if(begin, begin + n, [](card_t c) { return c > 0; }));
+    }
+
+    // Put `n` cards at the back, in at most two copies around the end of the ring
+    void append(const card_t* from, int n) {
+        int tail = (head + count) % deck::size;
+        int first = std::min(n, deck::size - tail);
+        std::copy(from, from + first, cards + tail);
+        std::copy(from + first, from + n, cards);
+        count = uint8_t(count + n);
+    }
+
+    // Copy the cards out in order
+    void copy_to(std::vector<card_t>& out) const {
+        int first = std::min<int>(count, deck::size - head);
+        out.insert(out.end(), cards + head, cards + head + first);
+        out.insert(out.end(), cards, cards + (count - first));
+    }
+};
+
+// Cards played to the current trick, in one cache line
+struct alignas(64) card_pile {
+    card_t cards[deck::size];
+    uint8_t count = 0;
+
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    void push_back(card_t card) { cards[count++] = card; }
+    void clear() { count = 0; }
+    const card_t* begin() const { return cards; }
+    const card_t* end() const { return cards + count; }
+};
+
+// Everything on the table: both hands and the pile, one cache line each, in
+// one contiguous block
+struct alignas(128) state_block {
+    player p1{1};
+    player p2{2};
+    card_pile pile;
+};
+
+// Memo of whole tricks for the trick-level engine. A trick started at a trick
+// boundary depends only on the first cards of the two hands, so it is keyed by
+// the first `window` cards of the leading hand and of the other hand, 3 bits a
+// card. An entry gives the cards taken from each hand, the face cards among
+// them and the pile in playing order, or 0 cards taken if the trick does not
+// end inside the windows. Direct-mapped, one table per thread.
+class trick_memo {
+public:
+    static constexpr int window = 8;
+
+    struct entry {
+        uint64_t key = ~uint64_t(0);
+        uint8_t from_lead = 0, from_other = 0;
+        uint8_t faces_lead = 0, faces_other = 0;
+        card_t pile[2 * window];
+
+        int size() const { return from_lead + from_other; }
+        bool resolved() const { return size() > 0; }
+        bool lead_takes() const { return (size() & 1) == 1; } // every card but the last switches player
+    };
+
+private:
+    static constexpr int bits = 10; // 32 KB: random deals rarely repeat a trick, so a miss must be cheap
+    std::vector<entry> table = std::vector<entry>(size_t(1) << bits);
+
+    // Play the trick on the two windows with the rules of game::turn()
+    static void solve(uint64_t key, entry& e) {
+        card_t cards[2][window];
+        for (int i = 0; i < window; ++i) {
+            cards[0][i] = card_t((key >> (3 * i)) & 7);
+            cards[1][i] = card_t((key >> (3 * (window + i))) & 7);
+        }
+        int taken[2] = {0, 0}, faces[2] = {0, 0};
+        int who = 0, penalty = 0, n = 0;
+        e.key = key;
+        e.from_lead = e.from_other = 0;
+        while (taken[who] < window) {
+            card_t card = cards[who][taken[who]++];
+            e.pile[n++] = card;
+            if (card > 0) {
+                faces[who]++;
+                penalty = card;
+                who ^= 1;
+            } else if (penalty > 0) {
+                if (--penalty == 0) {
+                    e.from_lead = uint8_t(taken[0]);
+                    e.from_other = uint8_t(taken[1]);
+                    e.faces_lead = uint8_t(faces[0]);
+                    e.faces_other = uint8_t(faces[1]);
+                    return;
+                }
+                who ^= 1;
+            } else {
+                who ^= 1;
+            }
+        }
+    }
+
+public:
+    long hits = 0, misses = 0;
+
+    static uint64_t window_key(const player& lead, const player& other) {
+        uint64_t key = 0;
+        for (int i = window - 1; i >= 0; --i) key = (key << 3) | other[i];
+        for (int i = window - 1; i >= 0; --i) key = (key << 3) | lead[i];
+        return key;
+    }
+
+    const entry& lookup(uint64_t key) {
+        entry& e = table[(key * 0x9e3779b97f4a7c15ull) >> (64 - bits)];
+        if (e.key == key) {
+            hits++;
+        } else {
+            misses++;
+            solve(key, e);
+        }
+        return e;
+    }
+
+    static trick_memo& local() {
+        thread_local trick_memo memo;
+        return memo;
+    }
+};
+
+// Scheduling classes of the thread pool. Workers always take the oldest task
+// of the most urgent non-empty class, so bulk work yields at the end of every
+// task it is split into: an urgent task waits at most for one bulk chunk.
+enum class task_priority { urgent, interactive, bulk };
+
+const char* task_priority_name(task_priority priority) {
+    switch (priority) {
+        case task_priority::urgent: return "urgent";
+        case task_priority::interactive: return "interactive";
+        default: return "bulk";
+    }
+}
+
+// Thread pool for managing worker threads
+class ThreadPool {
+private:
+    static constexpr int classes = 3;
+
+    struct queued_task {
+        std::function<void()> run;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    // Time from enqueue to start, per class
+    struct queue_latency {
+        long tasks = 0;
+        double total_us = 0;
+        double max_us = 0;
+    };
+
+    std::vector<std::thread> workers;
+    std::queue<queued_task> tasks[classes];
+    queue_latency latency[classes];
+    std::mutex queue_mutex;
+    std::condition_variable condition;
+    bool stop;
+    size_t active; // workers with a lower index take tasks, the others are parked
+
+    bool idle() const {
+        for (auto& q : tasks) {
+            if (!q.empty()) return false;
+        }
+        return true;
+    }
+
+    void work(size_t index) {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                condition.wait(lock, [this, index] { return stop || (index < active && !idle()); });
+                if (stop && (idle() || index >= active)) return;
+                int c = 0;
+                while (tasks[c].empty()) ++c;
+                double waited = std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - tasks[c].front().queued).count();
+                latency[c].tasks++;
+                latency[c].total_us += waited;
+                latency[c].max_us = std::max(latency[c].max_us, waited);
+                task = std::move(tasks[c].front().run);
+                tasks[c].pop();
+            }
+            task();
+        }
+    }
+
+public:
+    ThreadPool(size_t num_threads) : stop(false), active(num_threads) {
+        workers.reserve(num_threads);
+        for (size_t i = 0; i < num_threads; ++i) {
+            workers.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    // Change the number of workers that take tasks. A worker above the new
+    // count finishes its current task and then parks; new workers are started
+    // if there are not enough.
+    void set_active(size_t num_threads) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            active = std::max<size_t>(1, num_threads);
+            for (size_t i = workers.size(); i < active; ++i) {
+                workers.emplace_back([this, i] { work(i); });
+            }
+        }
+        condition.notify_all();
+    }
+
+    size_t active_count() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        return active;
+    }
+
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            stop = true;
+        }
+        condition.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    template<typename F, typename... Args>
+    auto enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result<F, Args...>::type> {
+        return enqueue(task_priority::bulk, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template<typename F, typename... Args>
+    auto enqueue(task_priority priority, F&& f, Args&&... args)
+        -> std::future<typename std::invoke_result<F, Args...>::type> {
+        using return_type = typename std::invoke_result<F, Args...>::type;
+        auto task = std::make_shared<std::packaged_task<return_type()>>(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+        );
+        std::future<return_type> res = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            tasks[int(priority)].push({[task]() { (*task)(); }, std::chrono::steady_clock::now()});
+        }
+        condition.notify_one();
+        return res;
+    }
+
+    // Drop the queued tasks of one class without running them. Their futures
+    // report std::future_errc::broken_promise. Returns the number dropped.
+    size_t drain(task_priority priority) {
+        std::queue<queued_task> dropped;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            std::swap(dropped, tasks[int(priority)]);
+        }
+        return dropped.size();
+    }
+
+    // Queue latency of every class that ran tasks so far
+    void print_latency(std::ostream& os) {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        for (int c = 0; c < classes; ++c) {
+            if (latency[c].tasks == 0) continue;
+            os << "Queue latency " << task_priority_name(task_priority(c)) << ": " << latency[c].tasks << " tasks, mean "
+               << latency[c].total_us / latency[c].tasks << " us, max " << latency[c].max_us << " us" << std::endl;
+        }
+    }
+};
+
+// Game state hash for cycle detection
+struct GameStateHash {
+    std::size_t operator()(const std::vector<card_t>& state) const {
+        std::size_t seed = state.size();
+        for (auto& i : state) {
+            seed ^= i + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    }
+};
+
+// Cheap behaviour descriptor of a game, filled in inline while it is played:
+// the winners of the first tricks as a bit string and a histogram of the pile
+// size at each pickup
+struct behaviour {
+    static constexpr int tracked_tricks = 64;
+    static constexpr int pile_buckets = 8;
+    uint64_t winners = 0; // bit t is set if player 2 won trick t
+    uint16_t pile_sizes[pile_buckets] = {};
+    uint16_t first_pile = 0; // pile size of the first trick
+    int tricks = 0;
+
+    void on_trick(int winner, size_t pile_size) {
+        if (tricks == 0) {
+            first_pile = uint16_t(pile_size);
+        }
+        if (tricks < tracked_tricks && winner == 2) {
+            winners |= uint64_t(1) << tricks;
+        }
+        // Buckets 2, 3, 4, 5-6, 7-9, 10-14, 15-20, 21+
+        static constexpr size_t limits[pile_buckets - 1] = {2, 3, 4, 6, 9, 14, 20};
+        int bucket = 0;
+        while (bucket < pile_buckets - 1 && pile_size > limits[bucket]) bucket++;
+        pile_sizes[bucket]++;
+        tricks++;
+    }
+
+    // Hamming distance of the winner bits plus L1 distance of the normalised
+    // pile histograms, each scaled to [0, 1]
+    double distance(const behaviour& o) const {
+        double d = __builtin_popcountll(winners ^ o.winners) / double(tracked_tricks);
+        double n1 = std::max(tricks, 1), n2 = std::max(o.tricks, 1);
+        double l1 = 0;
+        for (int i = 0; i < pile_buckets; ++i) {
+            l1 += std::abs(pile_sizes[i] / n1 - o.pile_sizes[i] / n2);
+        }
+        return d + l1 / 2;
+    }
+};
+
+// Archive of behaviours seen by novelty search, indexed for approximate nearest
+// neighbour queries by bit-sampling LSH over the winner bits: each table hashes
+// a fixed random subset of the bits, and candidates are the union of the buckets
+// a query falls into. With a size limit the oldest behaviour is replaced once
+// the archive is full.
+class novelty_archive {
+private:
+    static constexpr int tables = 8;
+    static constexpr int bits_per_key = 12;
+    std::vector<behaviour> items;
+    size_t max_items = 0; // 0 = unlimited
+    size_t oldest = 0;
+    int sampled_bits[tables][bits_per_key];
+    std::unordered_map<uint32_t, std::vector<uint32_t>> buckets[tables];
+
+    uint32_t key(int table, const behaviour& b) const {
+        uint32_t k = 0;
+        for (int i = 0; i < bits_per_key; ++i) {
+            k = (k << 1) | uint32_t((b.winners >> sampled_bits[table][i]) & 1);
+        }
+        return k;
+    }
+
+public:
+    explicit novelty_archive(std::mt19937& rng) {
+        std::uniform_int_distribution<> bit(0, behaviour::tracked_tricks - 1);
+        for (auto& table : sampled_bits) {
+            for (auto& b : table) b = bit(rng);
+        }
+    }
+
+    // Approximate memory per archived behaviour, bucket entries included
+    static constexpr size_t item_bytes = sizeof(behaviour) + tables * 4 * sizeof(uint32_t);
+
+    void set_limit(size_t bytes) {
+        max_items = bytes / item_bytes;
+    }
+
+    void add(const behaviour& b) {
+        uint32_t index = uint32_t(items.size());
+        if (max_items > 0 && items.size() >= max_items) {
+            index = uint32_t(oldest);
+            oldest = (oldest + 1) % items.size();
+            for (int t = 0; t < tables; ++t) {
+                auto it = buckets[t].find(key(t, items[index]));
+                auto& bucket = it->second;
+                bucket.erase(std::find(bucket.begin(), bucket.end(), index));
+                if (bucket.empty()) buckets[t].erase(it);
+            }
+            items[index] = b;
+        } else {
+            items.push_back(b);
+        }
+        for (int t = 0; t < tables; ++t) {
+            buckets[t][key(t, b)].push_back(index);
+        }
+    }
+
+    // Mean distance to the `k` nearest archived behaviours (and `extra` ones, e.g.
+    // the current population). A behaviour with no neighbours at all is maximally novel.
+    double novelty(const behaviour& b, int k, const std::vector<behaviour>& extra) const {
+        std::vector<uint32_t> candidates;
+        for (int t = 0; t < tables; ++t) {
+            auto it = buckets[t].find(key(t, b));
+            if (it != buckets[t].end()) {
+                candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+        std::vector<double> distances;
+        distances.reserve(candidates.size() + extra.size());
+        for (auto i : candidates) distances.push_back(b.distance(items[i]));
+        for (auto& e : extra) distances.push_back(b.distance(e));
+        if (distances.empty()) {
+            return 2.0;
+        }
+        size_t n = std::min(distances.size(), size_t(k));
+        std::partial_sort(distances.begin(), distances.begin() + n, distances.end());
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i) sum += distances[i];
+        return sum / n;
+    }
+
+    size_t size() const { return items.size(); }
+    size_t bytes() const { return items.size() * item_bytes; }
+};
+
+// MAP-Elites archive: a grid over cheap descriptors of a deal and its opening,
+// where each cell holds the longest game found with that descriptor. The
+// descriptors are the face cards and the aces dealt to player 1, and who won
+// the first trick with how large a pile. Workers swap elites into cells with
+// compare-and-swap. Replaced elites stay on an ownership list until the grid
+// is destroyed, so a reader never sees freed memory.
+class elite_grid {
+public:
+    struct elite {
+        DeckKey key;
+        int cards_played, tricks, winner;
+        elite* next_owned = nullptr;
+    };
+
+    static constexpr int face_bins = 17, ace_bins = 5, opening_bins = 6;
+    static constexpr int cells = face_bins * ace_bins * opening_bins;
+
+private:
+    std::atomic<elite*> slots[cells];
+    std::atomic<int> filled_cells[cells]; // cells in the order they were first filled
+    std::atomic<int> filled{0};
+    std::atomic<elite*> owned{nullptr};
+    std::atomic<size_t> owned_count{0};
+
+    void own(elite* e) {
+        e->next_owned = owned.load();
+        while (!owned.compare_exchange_weak(e->next_owned, e)) {}
+        owned_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+public:
+    elite_grid() {
+        for (int c = 0; c < cells; ++c) {
+            slots[c].store(nullptr);
+            filled_cells[c].store(-1);
+        }
+    }
+
+    ~elite_grid() {
+        for (elite* e = owned.load(); e;) {
+            elite* next = e->next_owned;
+            delete e;
+            e = next;
+        }
+    }
+
+    elite_grid(const elite_grid&) = delete;
+    elite_grid& operator=(const elite_grid&) = delete;
+
+    static int cell_of(const deck& d, const behaviour& b) {
+        int faces = 0, aces = 0;
+        for (int i = 0; i < deck::size / 2; ++i) {
+            faces += d.cards[i] > 0;
+            aces += d.cards[i] == 4;
+        }
+        int opening = 0;
+        if (b.tricks > 0) {
+            int pile = b.first_pile <= 3 ? 0 : b.first_pile <= 7 ? 1 : 2;
+            opening = int(b.winners & 1) * 3 + pile;
+        }
+        return (faces * ace_bins + aces) * opening_bins + opening;
+    }
+
+    // Returns true if the game became the elite of its cell
+    bool offer(int cell, const DeckKey& key, int cards_played, int tricks, int winner) {
+        elite* current = slots[cell].load();
+        if (winner <= 0 || (current && current->cards_played >= cards_played)) {
+            return false;
+        }
+        elite* e = new elite{key, cards_played, tricks, winner};
+        while (!slots[cell].compare_exchange_weak(current, e)) {
+            if (current && current->cards_played >= cards_played) {
+                delete e;
+                return false;
+            }
+        }
+        own(e);
+        if (!current) {
+            filled_cells[filled.fetch_add(1)].store(cell);
+        }
+        return true;
+    }
+
+    const elite* get(int cell) const {
+        return slots[cell].load();
+    }
+
+    // Elite of a random filled cell, or nullptr while there is none
+    const elite* random_elite(std::mt19937& rng) const {
+        int n = filled.load();
+        if (n == 0) return nullptr;
+        int cell = filled_cells[std::uniform_int_distribution<>(0, n - 1)(rng)].load();
+        return cell < 0 ? nullptr : slots[cell].load();
+    }
+
+    int size() const { return filled.load(); }
+
+    // The grid and every elite it has owned, replaced ones included
+    size_t bytes() const { return sizeof(*this) + owned_count.load() * sizeof(elite); }
+
+    // Sum of the elites' game lengths
+    long quality() const {
+        long sum = 0;
+        for (auto& slot : slots) {
+            if (const elite* e = slot.load()) sum += e->cards_played;
+        }
+        return sum;
+    }
+
+    // Elites in high_score.txt format, longest first
+    void write(std::ostream& out) const {
+        std::vector<const elite*> all;
+        for (auto& slot : slots) {
+            if (const elite* e = slot.load()) all.push_back(e);
+        }
+        std::sort(all.begin(), all.end(), [](const elite* a, const elite* b) { return a->cards_played > b->cards_played; });
+        for (const elite* e : all) {
+            out << e->cards_played << "," << e->tricks << "," << e->winner << "," << e->key << "\n";
+        }
+    }
+};
+
+// One picked-up trick, for comparing games move by move
+struct trick_event {
+    int moves; // cards played when the trick was picked up
+    int taker;
+    int pile;
+};
+
+// Cards played before a game is abandoned; `game` and the reference engine
+// must agree on it or long records fail verification
+constexpr int default_max_moves = 10000;
+
+class game {
+private:
+    state_block table;
+    deck d;
+    std::mt19937 rng;
+    
+    int cards_played_total = 0;
+    int tricks = 0;
+    int remaining_penalties = 0;
+    bool face_card_active = false;
+    player* active_player;
+    int max_moves = default_max_moves; // Limit to prevent infinite games
+    bool fast_forward = true;
+    bool trick_engine = true;
+    int first_player = 1;
+    
+    // For cycle detection
+    std::unordered_set<std::vector<card_t>, GameStateHash> seen_states;
+
+    // Dealt cards each player has played so far, kept by advance_until()
+    int dealt_played[2] = {0, 0};
+
+    // Optional behaviour descriptor, updated at every trick
+    behaviour* trace = nullptr;
+
+    // Optional dynamics profile, updated at every trick and at the end
+    dynamics_profile* dynamics = nullptr;
+
+    // Optional log of every trick
+    std::vector<trick_event>* trick_log = nullptr;
+
+    // Optional cancellation flag, checked before every move
+    const std::atomic<bool>* cancel = nullptr;
+
+public:
+    game() : rng(std::random_device{}()) {}
+
+    // A copy continues the same game with its own players
+    game(const game& other)
+        : table(other.table), d(other.d), rng(other.rng),
+          cards_played_total(other.cards_played_total), tricks(other.tricks),
+          remaining_penalties(other.remaining_penalties), face_card_active(other.face_card_active),
+          active_player(other.active_player == &other.table.p1 ? &table.p1 : &table.p2),
+          max_moves(other.max_moves), fast_forward(other.fast_forward), trick_engine(other.trick_engine),
+          first_player(other.first_player), seen_states(other.seen_states),
+          dealt_played{other.dealt_played[0], other.dealt_played[1]}, trace(other.trace),
+          dynamics(other.dynamics), trick_log(other.trick_log), cancel(other.cancel) {}
+
+    game& operator=(const game&) = delete;
+
+    void set_trace(behaviour* b) {
+        trace = b;
+    }
+
+    void set_dynamics(dynamics_profile* profile) {
+        dynamics = profile;
+    }
+
+    void set_trick_log(std::vector<trick_event>* log) {
+        trick_log = log;
+    }
+
+    // A cancelled game stops within one move and returns winner 0
+    void set_cancel(const std::atomic<bool>* flag) {
+        cancel = flag;
+    }
+
+    // Disables the closed-form endgame, e.g. to cross-check it against full simulation
+    void set_fast_forward(bool enabled) {
+        fast_forward = enabled;
+    }
+
+    // Plays card by card instead of trick by trick
+    void set_trick_engine(bool enabled) {
+        trick_engine = enabled;
+    }
+
+    void start() {
+        d.shuffle(rng);
+        deal(1);
+    }
+
+    void start(const position_bias& bias) {
+        d.shuffle(rng, bias);
+        deal(1);
+    }
+
+    // Replay an already generated deck, letting `first_player` lead the first trick
+    void start(const deck& dealt, int first_player = 1) {
+        d = dealt;
+        deal(first_player);
+    }
+
+    void deal(int first_player) {
+        this->first_player = first_player;
+        split_cards();
+        active_player = (first_player == 2) ? &table.p2 : &table.p1;
+        cards_played_total = 0;
+        tricks = 0;
+        table.pile.clear();
+        remaining_penalties = 0;
+        face_card_active = false;
+        seen_states.clear();
+        dealt_played[0] = dealt_played[1] = 0;
+    }
+
+    void split_cards() {
+        const int mid = deck::size / 2;
+        table.p1.assign(d.cards.data(), mid);
+        table.p2.assign(d.cards.data() + mid, deck::size - mid);
+    }
+
+    std::tuple<int, int, int, DeckKey> play() {
+        if (trick_engine) {
+            return play_tricks();
+        }
+        while (!is_game_over() && cards_played_total < max_moves) {
+            if (cancel && cancel->load(std::memory_order_relaxed)) {
+                return {0, cards_played_total, tricks, DeckKey::from_deck(d)};
+            }
+            if (fast_forward && !face_card_active && (probe_tablebase() || finish_endgame())) {
+                break;
+            }
+
+            // Check for cycles (same hands, pile, player to move and penalty)
+            auto state = current_state();
+            if (seen_states.count(state) > 0) {
+                // We've seen this exact state before - it's a cycle
+                if (dynamics) {
+                    dynamics->on_game(-1, cards_played_total, tricks);
+                }
+                return {-1, cards_played_total, tricks, DeckKey::from_deck(d)};
+            }
+            seen_states.insert(std::move(state));
+            
+            turn();
+        }
+        
+        if (dynamics) {
+            dynamics->on_game(is_game_over() ? active_player->id : 0, cards_played_total, tricks);
+        }
+        return {
+            active_player->id, 
+            cards_played_total, 
+            tricks,
+            DeckKey::from_deck(d)  // Return the deck that was used for this game
+        };
+    }
+
+    // Trick-level engine: one loop iteration per trick. At a trick boundary the
+    // whole trick comes from the memo; the few it cannot resolve (short hands,
+    // long tricks) are played card by card. Cycles are looked for at trick
+    // boundaries only. A state that repeats leads to a trick boundary that
+    // repeats, so the same games are found to cycle. Such a game, and one that
+    // reaches the move limit, is replayed card by card for the exact counters
+    // at which the card engine stops; both are rare.
+    std::tuple<int, int, int, DeckKey> play_tricks() {
+        // A copied game can stand inside a trick
+        while (!table.pile.empty() && !is_game_over() && cards_played_total < max_moves) {
+            turn();
+        }
+        trick_memo& memo = trick_memo::local();
+        while (!is_game_over() && cards_played_total < max_moves) {
+            if (cancel && cancel->load(std::memory_order_relaxed)) {
+                return {0, cards_played_total, tricks, DeckKey::from_deck(d)};
+            }
+            if (fast_forward && (probe_tablebase() || finish_endgame())) {
+                break;
+            }
+            if (!seen_states.insert(current_state()).second) {
+                return replay_by_card();
+            }
+            if (!memo_trick(memo)) {
+                do {
+                    turn();
+                } while (!table.pile.empty() && !is_game_over() && cards_played_total < max_moves);
+            }
+        }
+        if (!is_game_over()) {
+            return replay_by_card();
+        }
+        if (dynamics) {
+            dynamics->on_game(active_player->id, cards_played_total, tricks);
+        }
+        return {active_player->id, cards_played_total, tricks, DeckKey::from_deck(d)};
+    }
+
+    // Apply the trick that starts at this boundary from the memo: drop the
+    // played cards from the front of both hands and append the pile to the
+    // taker in one copy. Returns false if the memo cannot resolve it.
+    bool memo_trick(trick_memo& memo) {
+        player* lead = active_player;
+        player* other = (lead == &table.p1) ? &table.p2 : &table.p1;
+        if (lead->size() < trick_memo::window || other->size() < trick_memo::window) {
+            return false;
+        }
+        const trick_memo::entry& e = memo.lookup(trick_memo::window_key(*lead, *other));
+        // A hand that runs out inside the trick ends the game there
+        if (!e.resolved() || e.from_lead >= lead->size() || e.from_other >= other->size()) {
+            return false;
+        }
+        int n = e.size();
+        player* taker = e.lead_takes() ? lead : other;
+        lead->drop_front(e.from_lead);
+        other->drop_front(e.from_other);
+        lead->face_cards = uint8_t(lead->face_cards - e.faces_lead);
+        other->face_cards = uint8_t(other->face_cards - e.faces_other);
+        if (trace) {
+            trace->on_trick(taker->id, size_t(n));
+        }
+        taker->append(e.pile, n);
+        taker->face_cards = uint8_t(taker->face_cards + e.faces_lead + e.faces_other);
+        cards_played_total += n;
+        tricks++;
+        active_player = taker;
+        if (dynamics) {
+            dynamics->on_trick(size_t(n), e.faces_lead + e.faces_other, table.p1.size(), table.p2.size());
+        }
+        if (trick_log) {
+            trick_log->push_back({cards_played_total, taker->id, n});
+        }
+        return true;
+    }
+
+    // The same game from the deal, card by card
+    std::tuple<int, int, int, DeckKey> replay_by_card() {
+        game g;
+        g.max_moves = max_moves;
+        g.fast_forward = fast_forward;
+        g.trick_engine = false;
+        g.cancel = cancel;
+        g.start(d, first_player);
+        auto result = g.play();
+        int winner = std::get<0>(result);
+        if (dynamics && winner != 0) {
+            dynamics->on_game(winner > 0 && !g.is_game_over() ? 0 : winner, std::get<1>(result), std::get<2>(result));
+        }
+        return result;
+    }
+
+    bool is_game_over() const {
+        return table.p1.empty() || table.p2.empty();
+    }
+
+    // Play the opening of a freshly dealt game up to the last trick boundary
+    // before one of the `open` deck positions would be played. Dealt cards stay
+    // at the front of a hand until they are played, so their place is known.
+    // No states are recorded: they would hold the cards about to be refilled,
+    // so a continuation looks for cycles from the boundary on. Returns false if
+    // the game ended or hit the move limit first.
+    bool advance_until(const std::vector<bool>& open) {
+        const int half = deck::size / 2;
+        struct boundary {
+            state_block table;
+            int cards_played_total, tricks, mover, dealt_played[2];
+        };
+        auto save = [&] {
+            return boundary{table, cards_played_total, tricks, active_player == &table.p1 ? 0 : 1,
+                            {dealt_played[0], dealt_played[1]}};
+        };
+        boundary last = save();
+        while (!is_game_over() && cards_played_total < max_moves) {
+            int p = active_player == &table.p1 ? 0 : 1;
+            if (dealt_played[p] < half && open[p * half + dealt_played[p]]) {
+                table = last.table;
+                cards_played_total = last.cards_played_total;
+                tricks = last.tricks;
+                active_player = last.mover == 0 ? &table.p1 : &table.p2;
+                dealt_played[0] = last.dealt_played[0];
+                dealt_played[1] = last.dealt_played[1];
+                remaining_penalties = 0;
+                face_card_active = false;
+                return true;
+            }
+            if (dealt_played[p] < half) {
+                dealt_played[p]++;
+            }
+            turn();
+            if (table.pile.empty()) {
+                last = save();
+            }
+        }
+        return false;
+    }
+
+    // Put `card` at a deck position that advance_until() left unplayed
+    void refill(int position, int card) {
+        const int half = deck::size / 2;
+        int p = position / half;
+        player& owner = p == 0 ? table.p1 : table.p2;
+        card_t& slot = owner[position - p * half - dealt_played[p]];
+        owner.face_cards += (card > 0) - (slot > 0);
+        slot = card;
+        d.cards[position] = card_t(card);
+    }
+
+    // Everything the rest of the game depends on. The hands alone are not
+    // enough: the same hands can come round again with a different pile or
+    // penalty and play on to a different end.
+    // Cards are 0..4, so 255 separates the parts and 253-254 mark the player.
+    std::vector<card_t> current_state() const {
+        std::vector<card_t> state;
+        state.reserve(table.p1.size() + table.p2.size() + table.pile.size() + 4);
+        table.p1.copy_to(state);
+        state.push_back(255);
+        table.p2.copy_to(state);
+        state.push_back(255);
+        state.insert(state.end(), table.pile.begin(), table.pile.end());
+        state.push_back(card_t(255 - active_player->id));
+        state.push_back(card_t(remaining_penalties));
+        return state;
+    }
+
+    // Closed-form end of the game. With no penalty running the players simply
+    // alternate, so if one of them holds no face cards, it either runs out before
+    // the opponent turns up a face card, or it does not. In the first case no
+    // more tricks are played and the game ends after a known number of moves,
+    // which are skipped. The cycle check would not have fired on them either: a
+    // game that repeats a state never ends.
+    bool finish_endgame() {
+        player* mover = active_player;
+        player* other = (active_player == &table.p1) ? &table.p2 : &table.p1;
+        player* faceless = mover->face_cards == 0 ? mover : other->face_cards == 0 ? other : nullptr;
+        if (!faceless) {
+            return false;
+        }
+
+        // The faceless player runs out on its n-th card: move 2n-1 if it moves
+        // first, move 2n otherwise. The opponent plays n-1 or n cards before
+        // that, which all have to be non-face cards.
+        int n = int(faceless->size());
+        int end = (faceless == mover) ? 2 * n - 1 : 2 * n;
+        player* opponent = (faceless == mover) ? other : mover;
+        int opponent_cards = (faceless == mover) ? n - 1 : n;
+        if (cards_played_total + end > max_moves) {
+            return false;
+        }
+        if (int(opponent->size()) <= opponent_cards) {
+            return false;
+        }
+        for (int i = 0; i < opponent_cards; ++i) {
+            if ((*opponent)[i] > 0) {
+                return false;
+            }
+        }
+
+        cards_played_total += end;
+        faceless->clear();
+        opponent->drop_front(opponent_cards);
+        active_player = opponent;
+        return true;
+    }
+
+    // Finish the game from the endgame tablebase at a trick boundary. As above,
+    // a window that ends the game cannot contain a repeated state. Games with a
+    // behaviour trace or dynamics profile are always simulated so that every
+    // trick is seen.
+    bool probe_tablebase() {
+        if (!endgame_table || trace || dynamics || !table.pile.empty()) {
+            return false;
+        }
+        player* small = table.p1.size() <= table.p2.size() ? &table.p1 : &table.p2;
+        player* big = (small == &table.p1) ? &table.p2 : &table.p1;
+        int remaining_cards, remaining_tricks;
+        if (!endgame_table->probe(*small, *big, active_player == small, remaining_cards, remaining_tricks) ||
+            cards_played_total + remaining_cards > max_moves) {
+            return false;
+        }
+        cards_played_total += remaining_cards;
+        tricks += remaining_tricks;
+        small->clear();
+        active_player = big;
+        return true;
+    }
+
+    void turn() {
+        if (active_player->empty()) {
+            return;
+        }
+
+        int card = active_player->front();
+        active_player->pop_front();
+        table.pile.push_back(card_t(card));
+        cards_played_total++;
+        
+        if (card > 0) { // Face card played
+            active_player->face_cards--;
+            face_card_active = true;
+            remaining_penalties = card;
+            switch_player();
+        } else if (face_card_active) {
+            remaining_penalties--;
+            if (remaining_penalties == 0) {
+                // Trick completed, current player takes all cards
+                tricks++;
+                face_card_active = false;
+                if (trace) {
+                    trace->on_trick(active_player->id, table.pile.size());
+                }
+                
+                // Add cards to the back of player's hand
+                active_player->append(table.pile.cards, table.pile.size());
+                int faces = int(std::count_if(table.pile.begin(), table.pile.end(), [](card_t c) { return c > 0; }));
+                active_player->face_cards += faces;
+                if (dynamics) {
+                    dynamics->on_trick(table.pile.size(), faces, table.p1.size(), table.p2.size());
+                }
+                if (trick_log) {
+                    trick_log->push_back({cards_played_total, active_player->id, int(table.pile.size())});
+                }
+                table.pile.clear();
+            } else {
+                switch_player();
+            }
+        } else {
+            switch_player();
+        }
+    }
+
+    void switch_player() {
+        active_player = (active_player == &table.p1) ? &table.p2 : &table.p1;
+    }
+};
+
+// Function to run a single game simulation
+std::tuple<int, int, int, DeckKey> run_game_simulation(const position_bias* bias = nullptr,
+                                                       dynamics_profile* dynamics = nullptr,
+                                                       const std::atomic<bool>* cancel = nullptr) {
+    game g;
+    g.set_dynamics(dynamics);
+    g.set_cancel(cancel);
+    if (bias) {
+        g.start(*bias);
+    } else {
+        g.start();
+    }
+    return g.play();
+}
+
+// Evaluate every start variant of one generated deal. Swapping the two hands is
+// the same game as letting the other player lead with the player labels mirrored,
+// so the distinct variants are just the two choices of starting player. The deck
+// is generated and split once and each variant replays it from the same data.
+// Returns the longest finished variant and the player that started it.
+std::tuple<int, int, int, DeckKey, int> run_deal_variants(const position_bias* bias = nullptr,
+                                                          dynamics_profile* dynamics = nullptr,
+                                                          const std::atomic<bool>* cancel = nullptr) {
+    game g;
+    g.set_dynamics(dynamics);
+    g.set_cancel(cancel);
+    if (bias) {
+        g.start(*bias);
+    } else {
+        g.start();
+    }
+    auto best = g.play();
+    int best_start = 1;
+
+    g.deal(2);
+    auto other = g.play();
+    bool other_better = std::get<0>(other) > 0 &&
+        (std::get<0>(best) <= 0 || std::get<1>(other) > std::get<1>(best));
+    if (other_better) {
+        best = other;
+        best_start = 2;
+    }
+
+    auto [winner, cards_played, tricks, game_deck] = best;
+    return {winner, cards_played, tricks, game_deck, best_start};
+}
+
+// Reduction of a batch of games: the longest finished game and a histogram of
+// game lengths. Ties are broken on the deck, so merging is associative and
+// commutative and every backend reduces a batch to the same summary.
+struct batch_summary {
+    static constexpr int bucket_width = 100;
+    static constexpr int buckets = 101; // the last one collects games at the move limit
+    long games = 0;
+    long cycles = 0;
+    long lengths[buckets] = {};
+    int winner = 0, cards_played = 0, tricks = 0, start_player = 1;
+    DeckKey best{};
+
+    void add(const std::tuple<int, int, int, DeckKey>& result, int start) {
+        auto [w, c, t, key] = result;
+        games++;
+        if (w <= 0) {
+            cycles++;
+            return;
+        }
+        lengths[std::min(c / bucket_width, buckets - 1)]++;
+        if (c > cards_played || (c == cards_played && winner > 0 && key < best)) {
+            winner = w;
+            cards_played = c;
+            tricks = t;
+            start_player = start;
+            best = key;
+        }
+    }
+
+    void merge(const batch_summary& other) {
+        games += other.games;
+        cycles += other.cycles;
+        for (int i = 0; i < buckets; ++i) lengths[i] += other.lengths[i];
+        if (other.winner > 0 && (other.cards_played > cards_played ||
+                                 (other.cards_played == cards_played && (winner <= 0 || other.best < best)))) {
+            winner = other.winner;
+            cards_played = other.cards_played;
+            tricks = other.tricks;
+            start_player = other.start_player;
+            best = other.best;
+        }
+    }
+
+    bool operator==(const batch_summary& other) const {
+        return games == other.games && cycles == other.cycles &&
+               std::equal(lengths, lengths + buckets, other.lengths) &&
+               winner == other.winner && cards_played == other.cards_played && best == other.best;
+    }
+
+    void print(std::ostream& os) const {
+        os << "Game lengths (" << games << " games, " << cycles << " cycles):\n";
+        for (int i = 0; i < buckets; ++i) {
+            if (lengths[i] == 0) continue;
+            os << "  " << i * bucket_width << "-" << (i + 1) * bucket_width - 1 << ": " << lengths[i] << "\n";
+        }
+    }
+};
+
+// Play one generated deal (both start variants if requested) into a summary
+batch_summary evaluate_deal(const deck& dealt, bool variants, feature_collector* features) {
+    batch_summary s;
+    game g;
+    for (int start = 1; start <= (variants ? 2 : 1); ++start) {
+        g.start(dealt, start);
+        auto result = g.play();
+        if (features && std::get<0>(result) > 0) {
+            features->add(std::get<3>(result), std::get<1>(result), start);
+        }
+        s.add(result, start);
+    }
+    return s;
+}
+
+batch_summary merge_summaries(batch_summary a, const batch_summary& b) {
+    a.merge(b);
+    return a;
+}
+
+// Reduce a buffer of deals with the standard parallel algorithms (TBB with
+// libstdc++). A game allocates and takes locks in its hash set, so the policy
+// is par rather than par_unseq.
+batch_summary reduce_std(const std::vector<deck>& decks, size_t n, bool variants, feature_collector* features) {
+    return std::transform_reduce(std::execution::par, decks.begin(), decks.begin() + n, batch_summary{},
+                                 merge_summaries,
+                                 [variants, features](const deck& d) { return evaluate_deal(d, variants, features); });
+}
+
+// The same reduction on the thread pool, one slice of the buffer per task
+batch_summary reduce_pool(ThreadPool& pool, int num_threads, const std::vector<deck>& decks, size_t n,
+                          bool variants, feature_collector* features) {
+    size_t slices = std::max<size_t>(1, std::min(n, size_t(num_threads) * 8));
+    std::vector<std::future<batch_summary>> results;
+    for (size_t s = 0; s < slices; ++s) {
+        size_t begin = n * s / slices, end = n * (s + 1) / slices;
+        results.push_back(pool.enqueue([&decks, begin, end, variants, features] {
+            batch_summary out;
+            for (size_t i = begin; i < end; ++i) out.merge(evaluate_deal(decks[i], variants, features));
+            return out;
+        }));
+    }
+    batch_summary total;
+    for (auto& result : results) total.merge(result.get());
+    return total;
+}
+
+struct search_options {
+    long num_games = 100000;
+    int num_threads = std::thread::hardware_concurrency();
+    int high_score = 0;
+    bool variants = false;
+    bool novelty = false;
+    bool map_elites = false;
+    std::string elites_file;
+    bool lns = false;
+    int lns_k = 6;
+    std::string lns_destroy = "mixed";
+    long lns_samples = 1024;
+    std::string lns_from;
+    int population = 256;
+    std::string features_file;
+    bool bias = false;
+    double bias_strength = 4.0;
+    long bias_interval = 20000;
+    std::string dynamics_file;
+    long dynamics_sample = 16;
+    size_t dedup_bytes = 0;
+    page_mode pages = page_mode::transparent;
+    bool numa_interleave = false;
+    size_t table_bench_bytes = 0;
+    std::string tablebase_file;
+    bool std_backend = false;
+    long backend_bench_deals = 0;
+    long engine_bench_deals = 0;
+    int target = 0; // stop once a game is longer than this
+    size_t memory_bytes = 0;
+    std::string control_path;
+};
+
+// Search parameters that can change while a search runs. The searches read
+// them at work-unit boundaries (a batch, a generation, a progress report), so
+// a change takes effect without pausing the pool. Set from the options at
+// startup and by control_channel afterwards.
+struct search_tuning {
+    std::atomic<long> progress_interval{10000};
+    std::atomic<int> max_swaps{3}; // mutations swap 1..max_swaps pairs of cards
+    std::atomic<double> bias_strength{4.0};
+    std::atomic<long> bias_interval{20000};
+    std::atomic<int> lns_k{6};
+    std::atomic<long> lns_samples{1024};
+
+    // Games count at which the next progress report is due
+    long next_report(long games) const {
+        long interval = progress_interval;
+        return (games / interval + 1) * interval;
+    }
+};
+
+search_tuning tuning;
+
+// Best finished game so far. A game that beats it becomes a candidate and
+// raises the bar for the search at once, but is only appended to
+// high_score.txt once result_checks has reproduced it with the reference
+// engine. When start variants are evaluated the starting player is a fifth
+// field.
+class leaderboard {
+private:
+    std::ofstream& file;
+    bool with_start;
+
+public:
+    int high_score;      // best candidate, verified or not
+    int persisted_score; // best game written to the file
+
+    leaderboard(std::ofstream& file, int high_score, bool with_start)
+        : file(file), with_start(with_start), high_score(high_score), persisted_score(high_score) {}
+
+    bool offer(int winner, int cards_played, int tricks, int start_player = 1) {
+        // Only record valid games (not cycles)
+        if (winner <= 0 || cards_played <= high_score) {
+            return false;
+        }
+        high_score = cards_played;
+
+        std::cout << "New high score: " << high_score 
+                  << " cards, " << tricks << " tricks, winner: Player " 
+                  << winner;
+        if (with_start) {
+            std::cout << ", started by Player " << start_player;
+        }
+        std::cout << std::endl;
+        return true;
+    }
+
+    // Write a verified candidate. Verifications can finish out of order, so
+    // one that has been overtaken by a longer verified game is dropped.
+    // A game that beat --target is written even if it is not a record.
+    void persist(int winner, int cards_played, int tricks, const DeckKey& game_deck, int start_player,
+                 bool target = false) {
+        if (cards_played <= persisted_score && !target) {
+            return;
+        }
+        persisted_score = std::max(persisted_score, cards_played);
+        file << cards_played << "," << tricks << "," << winner << "," << game_deck;
+        if (with_start) {
+            file << "," << start_player;
+        }
+        file << "\n";
+        file.flush();
+    }
+
+    // A candidate failed verification: lower the bar again unless a later
+    // candidate has already replaced it
+    void reject(int cards_played) {
+        if (high_score == cards_played) {
+            high_score = persisted_score;
+        }
+    }
+};
+
+// Stop message for --target, naming the game that beat it
+void print_target(int target, int winner, int cards_played, int tricks, const DeckKey& key, int start_player,
+                  bool with_start, const std::string& tail) {
+    std::cout << "Target of " << target << " cards exceeded by " << cards_played << " cards, " << tricks
+              << " tricks, winner: Player " << winner;
+    if (with_start) {
+        std::cout << ", started by Player " << start_player;
+    }
+    std::cout << ": " << key << tail << std::endl;
+}
+
+void print_rate(long games_completed, std::chrono::high_resolution_clock::time_point start_time) {
+    auto now = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
+    std::cout << "Completed " << games_completed << " games. "
+              << "Games per second: " << (games_completed / (duration + 0.1)) << std::endl;
+}
+
+// Replay a deal by plain simulation, card by card, without the closed-form endgame or the tablebase
+std::tuple<int, int, int, DeckKey> replay_plain(const DeckKey& key, int start_player) {
+    game g;
+    g.set_fast_forward(false);
+    g.set_trick_engine(false);
+    g.start(key.to_deck(), start_player);
+    return g.play();
+}
+
+// Reference engine for verifying records. It shares no code with `game`: the
+// hands are deques played card by card, every state is kept in an ordered set,
+// and nothing is skipped. Returns winner (-1 for a cycle), cards played and
+// tricks, and logs every trick.
+std::tuple<int, int, int> reference_play(const deck& dealt, int start_player, std::vector<trick_event>& log) {
+    const int half = deck::size / 2;
+    std::deque<int> hands[2] = {
+        std::deque<int>(dealt.cards.begin(), dealt.cards.begin() + half),
+        std::deque<int>(dealt.cards.begin() + half, dealt.cards.end()),
+    };
+    std::vector<int> pile;
+    int active = start_player == 2 ? 1 : 0;
+    int penalty = 0, moves = 0, tricks = 0;
+    std::set<std::vector<int>> seen;
+    while (!hands[0].empty() && !hands[1].empty() && moves < default_max_moves) {
+        std::vector<int> state(hands[0].begin(), hands[0].end());
+        state.push_back(-1);
+        state.insert(state.end(), hands[1].begin(), hands[1].end());
+        state.push_back(-1);
+        state.insert(state.end(), pile.begin(), pile.end());
+        state.push_back(-2 - active);
+        state.push_back(penalty);
+        if (!seen.insert(std::move(state)).second) {
+            return {-1, moves, tricks};
+        }
+
+        int card = hands[active].front();
+        hands[active].pop_front();
+        pile.push_back(card);
+        moves++;
+        if (card > 0) {
+            penalty = card;
+            active = 1 - active;
+        } else if (penalty > 0 && --penalty == 0) {
+            hands[active].insert(hands[active].end(), pile.begin(), pile.end());
+            tricks++;
+            log.push_back({moves, active + 1, int(pile.size())});
+            pile.clear();
+        } else {
+            active = 1 - active;
+        }
+    }
+    return {active + 1, moves, tricks};
+}
+
+// Re-checks of new records (urgent) and reported cycles (interactive). They
+// run on the search pool ahead of the queued bulk games, and their reports are
+// handled by the thread that collects results: a record that the reference
+// engine reproduces is written to the leaderboard's file, one that it does not
+// is rejected and written to the quarantine file with the trick logs of both
+// engines.
+class result_checks {
+private:
+    struct check {
+        std::string line;            // "cycle", "" for a cycle that does not reproduce, or a record report
+        std::string quarantine;      // trick logs of a rejected record
+        std::function<void()> apply; // updates the leaderboard
+    };
+
+    ThreadPool& pool;
+    leaderboard& board;
+    std::string quarantine_file;
+    std::vector<std::future<check>> pending;
+    long cycles_checked = 0;
+    long cycles_confirmed = 0;
+
+public:
+    result_checks(ThreadPool& pool, leaderboard& board, std::string quarantine_file = "quarantine.txt")
+        : pool(pool), board(board), quarantine_file(std::move(quarantine_file)) {}
+
+    // Verify a candidate record, or with `target` a game that beat --target,
+    // which is written whatever the current high score is
+    void record(int winner, int cards_played, int tricks, const DeckKey& key, int start_player, bool target = false) {
+        leaderboard* b = &board;
+        pending.push_back(pool.enqueue(task_priority::urgent, [=] {
+            check result;
+            std::vector<trick_event> reference_log;
+            auto [w, c, t] = reference_play(key.to_deck(), start_player, reference_log);
+            if (w == winner && c == cards_played && t == tricks) {
+                result.line = std::string(target ? "Verified target game: " : "Verified record: ") +
+                              std::to_string(c) + " cards, " + std::to_string(t) + " tricks";
+                result.apply = [=] { b->persist(winner, cards_played, tricks, key, start_player, target); };
+                return result;
+            }
+            result.line = "Record of " + std::to_string(cards_played) + " cards does NOT reproduce: reference gives " +
+                          std::to_string(c) + " cards, " + std::to_string(t) + " tricks, winner " +
+                          std::to_string(w) + "; quarantined";
+            result.apply = [=] { b->reject(cards_played); };
+
+            // Trick log of the search engine, played card by card without
+            // shortcuts: the trick memo's replay and the endgame shortcuts
+            // would leave gaps in the log
+            std::vector<trick_event> engine_log;
+            game g;
+            g.set_trick_engine(false);
+            g.set_fast_forward(false);
+            g.set_trick_log(&engine_log);
+            g.start(key.to_deck(), start_player);
+            g.play();
+            std::ostringstream out;
+            out << "# candidate," << cards_played << "," << tricks << "," << winner << "," << key << "," << start_player << "\n"
+                << "# reference," << c << "," << t << "," << w << "\n"
+                << "# trick,engine_moves,engine_taker,engine_pile,reference_moves,reference_taker,reference_pile\n";
+            for (size_t i = 0; i < std::max(engine_log.size(), reference_log.size()); ++i) {
+                out << i;
+                for (auto* log : {&engine_log, &reference_log}) {
+                    if (i < log->size()) {
+                        out << "," << (*log)[i].moves << "," << (*log)[i].taker << "," << (*log)[i].pile;
+                    } else {
+                        out << ",,,";
+                    }
+                }
+                out << "\n";
+            }
+            result.quarantine = out.str();
+            return result;
+        }));
+    }
+
+    void cycle(const DeckKey& key, int start_player) {
+        pending.push_back(pool.enqueue(task_priority::interactive, [=] {
+            check result;
+            result.line = std::get<0>(replay_plain(key, start_player)) == -1 ? "cycle" : "";
+            return result;
+        }));
+    }
+
+    // Handle the checks that have finished; with `wait`, all of them
+    void report(bool wait) {
+        auto ready = [wait](std::future<check>& f) {
+            return wait || f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        };
+        auto keep = std::partition(pending.begin(), pending.end(), [&](auto& f) { return !ready(f); });
+        for (auto it = keep; it != pending.end(); ++it) {
+            check c = it->get();
+            if (c.apply) {
+                c.apply();
+            }
+            if (!c.quarantine.empty()) {
+                std::ofstream out(quarantine_file, std::ios_base::app);
+                out << c.quarantine;
+            }
+            if (c.line == "cycle") {
+                cycles_checked++;
+                cycles_confirmed++;
+            } else if (c.line.empty()) {
+                cycles_checked++;
+                std::cout << "Reported cycle does not reproduce" << std::endl;
+            } else {
+                std::cout << c.line << std::endl;
+            }
+        }
+        pending.erase(keep, pending.end());
+        if (wait && cycles_checked > 0) {
+            std::cout << "Cycles confirmed by replay: " << cycles_confirmed << "/" << cycles_checked << std::endl;
+        }
+    }
+};
+
+long run_random_search(const search_options& opt, ThreadPool& pool, leaderboard& board, result_checks& checks,
+                       feature_collector* features, dynamics_collector* dynamics, memory_budget::component* queue_memory,
+                       std::chrono::high_resolution_clock::time_point start_time) {
+    long games_completed = 0;
+    long next_bias = tuning.bias_interval;
+    long next_report = tuning.next_report(0);
+
+    // Without a memory grant every game is queued up front; with one, only as
+    // many as fit in it are in flight at a time
+    constexpr size_t queued_game_bytes = 256; // future, packaged task and queue entry
+    long window = opt.num_games;
+    if (queue_memory && queue_memory->granted > 0) {
+        window = std::max<long>(opt.num_threads * 4, long(queue_memory->granted / queued_game_bytes));
+    }
+
+    // In variants mode every task evaluates all start variants of its deal and
+    // reports the best one. With a live bias each task draws its deal from the
+    // bias published when it starts. Sampled games are profiled into the
+    // worker's dynamics profile.
+    //
+    // With a target, the worker that finishes a longer game keeps it in
+    // `target_game` and raises `cancel`: games in progress stop at their next
+    // move, and the collector drops the queued games and stops launching new
+    // ones.
+    std::atomic<bool> cancel{false};
+    std::mutex target_mutex;
+    std::tuple<int, int, int, DeckKey, int> target_game{0, 0, 0, DeckKey{}, 1};
+    auto launch = [&opt, &pool, &cancel, &target_mutex, &target_game, features, dynamics] {
+        return pool.enqueue([&opt, &cancel, &target_mutex, &target_game, features, dynamics] {
+            std::shared_ptr<const position_bias> bias;
+            if (features && opt.bias) {
+                bias = features->current_bias();
+            }
+            auto play = [&](dynamics_profile* profile) -> std::tuple<int, int, int, DeckKey, int> {
+                if (opt.variants) {
+                    return run_deal_variants(bias.get(), profile, &cancel);
+                }
+                auto [winner, cards_played, tricks, game_deck] = run_game_simulation(bias.get(), profile, &cancel);
+                return {winner, cards_played, tricks, game_deck, 1};
+            };
+            auto result = dynamics ? dynamics->sample(play) : play(nullptr);
+            if (opt.target > 0 && std::get<0>(result) > 0 && std::get<1>(result) > opt.target) {
+                std::lock_guard<std::mutex> lock(target_mutex);
+                if (std::get<1>(result) > std::get<1>(target_game)) {
+                    target_game = result;
+                }
+                cancel = true;
+            }
+            if (features && std::get<0>(result) > 0) {
+                features->add(std::get<3>(result), std::get<1>(result), std::get<4>(result));
+            }
+            return result;
+        });
+    };
+
+    std::deque<std::future<std::tuple<int, int, int, DeckKey, int>>> results;
+    long queued = 0;
+    bool drained = false;
+    while (queued < opt.num_games || !results.empty()) {
+        if (cancel && !drained) {
+            size_t dropped = pool.drain(task_priority::bulk);
+            std::lock_guard<std::mutex> lock(target_mutex);
+            auto [winner, cards_played, tricks, game_deck, start_player] = target_game;
+            print_target(opt.target, winner, cards_played, tricks, game_deck, start_player, opt.variants,
+                         "; " + std::to_string(dropped) + (opt.variants ? " queued deals" : " queued games") + " dropped");
+            drained = true;
+            queued = opt.num_games;
+        }
+        for (; queued < opt.num_games && long(results.size()) < window; ++queued) {
+            results.push_back(launch());
+        }
+        if (queue_memory) {
+            queue_memory->set_used(results.size() * queued_game_bytes);
+        }
+
+        // Collect results in order
+        auto result = std::move(results.front());
+        results.pop_front();
+        try {
+            auto [winner, cards_played, tricks, game_deck, start_player] = result.get();
+            if (winner == 0) {
+                continue; // cancelled
+            }
+            games_completed += opt.variants ? 2 : 1;
+            
+            if (opt.target > 0 && winner > 0 && cards_played > opt.target) {
+                // the longest of these is in target_game and recorded below
+            } else if (board.offer(winner, cards_played, tricks, start_player)) {
+                checks.record(winner, cards_played, tricks, game_deck, start_player);
+            } else if (winner == -1) {
+                checks.cycle(game_deck, start_player);
+            }
+            
+            // Progress update
+            if (games_completed >= next_report) {
+                print_rate(games_completed, start_time);
+                checks.report(false);
+                next_report = tuning.next_report(games_completed);
+            }
+            if (features && opt.bias && games_completed >= next_bias) {
+                features->refresh_bias(tuning.bias_strength);
+                next_bias += tuning.bias_interval;
+            }
+        } catch (const std::future_error&) {
+            // dropped from the queue after the target was reached
+        } catch (const std::exception& e) {
+            std::cerr << "Error in game simulation: " << e.what() << std::endl;
+        }
+    }
+    if (std::get<0>(target_game) > 0) {
+        auto [winner, cards_played, tricks, game_deck, start_player] = target_game;
+        board.offer(winner, cards_played, tricks, start_player);
+        checks.record(winner, cards_played, tricks, game_deck, start_player, true);
+    }
+    return games_completed;
+}
+
+// Random search on the standard parallel algorithms: fill a fixed-size buffer
+// with deals, then reduce it to the best game and a length histogram
+long run_std_search(const search_options& opt, leaderboard& board, result_checks& checks, feature_collector* features,
+                    memory_budget::component* buffer_memory, std::chrono::high_resolution_clock::time_point start_time) {
+    constexpr size_t deal_bytes = sizeof(deck);
+    size_t batch_size = 1 << 14;
+    if (buffer_memory && buffer_memory->granted > 0) {
+        batch_size = std::clamp<size_t>(buffer_memory->granted / deal_bytes, 256, batch_size);
+    }
+    std::mt19937 rng(std::random_device{}());
+    std::vector<deck> decks(batch_size);
+    if (buffer_memory) {
+        buffer_memory->set_used(batch_size * deal_bytes);
+    }
+    batch_summary total;
+    long deals_done = 0;
+    long next_report = tuning.next_report(0);
+    long next_bias = tuning.bias_interval;
+
+    while (deals_done < opt.num_games) {
+        size_t n = size_t(std::min<long>(batch_size, opt.num_games - deals_done));
+        std::shared_ptr<const position_bias> bias;
+        if (features && opt.bias) {
+            bias = features->current_bias();
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (bias) {
+                decks[i].shuffle(rng, *bias);
+            } else {
+                decks[i].shuffle(rng);
+            }
+        }
+
+        batch_summary batch = reduce_std(decks, n, opt.variants, features);
+        bool hit = opt.target > 0 && batch.winner > 0 && batch.cards_played > opt.target;
+        if (board.offer(batch.winner, batch.cards_played, batch.tricks, batch.start_player) || hit) {
+            checks.record(batch.winner, batch.cards_played, batch.tricks, batch.best, batch.start_player, hit);
+        }
+        checks.report(false);
+        total.merge(batch);
+        deals_done += long(n);
+        if (hit) {
+            print_target(opt.target, batch.winner, batch.cards_played, batch.tricks, batch.best, batch.start_player,
+                         opt.variants, " after " + std::to_string(total.games) + " games");
+            break;
+        }
+
+        if (total.games >= next_report) {
+            print_rate(total.games, start_time);
+            next_report = tuning.next_report(total.games);
+        }
+        if (features && opt.bias && total.games >= next_bias) {
+            features->refresh_bias(tuning.bias_strength);
+            next_bias = total.games + tuning.bias_interval;
+        }
+    }
+    total.print(std::cout);
+    return total.games;
+}
+
+// MAP-Elites: every worker repeatedly picks the elite of a random filled cell,
+// mutates it, plays the child with a behaviour trace and offers it to the cell
+// its descriptors fall into. The first `population` games are random deals to
+// seed the grid. Work is handed out in generations only for progress reports
+// and the leaderboard; the grid itself is shared by all workers throughout.
+long run_map_elites(const search_options& opt, ThreadPool& pool, leaderboard& board, result_checks& checks,
+                    feature_collector* features, dedup_filter* seen, memory_budget::component* grid_memory,
+                    std::chrono::high_resolution_clock::time_point start_time) {
+    elite_grid grid;
+    std::random_device seed_source;
+    long games_completed = 0;
+    long next_report = tuning.next_report(0);
+    std::tuple<int, int, int, DeckKey> target_game{0, 0, 0, DeckKey{}};
+
+    while (games_completed < opt.num_games) {
+        int batch = int(std::min<long>(opt.population * 4L, opt.num_games - games_completed));
+        bool seeding = games_completed < opt.population;
+        int slices = std::max(1, std::min(int(pool.active_count()), batch));
+        std::vector<std::future<std::tuple<int, int, int, DeckKey>>> results;
+        for (int s = 0; s < slices; ++s) {
+            int count = batch * (s + 1) / slices - batch * s / slices;
+            unsigned seed = seed_source();
+            results.push_back(pool.enqueue([&, count, seed] {
+                std::mt19937 rng(seed);
+                std::tuple<int, int, int, DeckKey> best{0, 0, 0, DeckKey{}};
+                game g;
+                deck child;
+                for (int i = 0; i < count; ++i) {
+                    const elite_grid::elite* parent = seeding ? nullptr : grid.random_elite(rng);
+                    for (int attempt = 0; attempt < 8; ++attempt) {
+                        if (parent) {
+                            child = parent->key.to_deck();
+                            child.mutate(rng, std::uniform_int_distribution<>(1, tuning.max_swaps)(rng));
+                        } else {
+                            child.shuffle(rng);
+                        }
+                        if (!seen || seen->insert(DeckKey::from_deck(child))) break;
+                    }
+                    behaviour b;
+                    g.set_trace(&b);
+                    g.start(child);
+                    auto result = g.play();
+                    auto [winner, cards_played, tricks, game_deck] = result;
+                    if (features && winner > 0) {
+                        features->add(game_deck, cards_played, 1);
+                    }
+                    grid.offer(elite_grid::cell_of(child, b), game_deck, cards_played, tricks, winner);
+                    if (winner > 0 && cards_played > std::get<1>(best)) {
+                        best = result;
+                    }
+                }
+                return best;
+            }));
+        }
+
+        for (auto& result : results) {
+            auto [winner, cards_played, tricks, game_deck] = result.get();
+            if (opt.target > 0 && winner > 0 && cards_played > opt.target) {
+                if (cards_played > std::get<1>(target_game)) {
+                    target_game = {winner, cards_played, tricks, game_deck};
+                }
+            } else if (board.offer(winner, cards_played, tricks)) {
+                checks.record(winner, cards_played, tricks, game_deck, 1);
+            }
+        }
+        games_completed += batch;
+        grid_memory->set_used(grid.bytes());
+        if (std::get<0>(target_game) > 0) {
+            auto [winner, cards_played, tricks, game_deck] = target_game;
+            board.offer(winner, cards_played, tricks);
+            checks.record(winner, cards_played, tricks, game_deck, 1, true);
+            print_target(opt.target, winner, cards_played, tricks, game_deck, 1, false,
+                         " after " + std::to_string(games_completed) + " games");
+            break;
+        }
+
+        if (games_completed >= next_report) {
+            print_rate(games_completed, start_time);
+            checks.report(false);
+            std::cout << "MAP-Elites: " << grid.size() << "/" << elite_grid::cells << " cells filled, quality "
+                      << grid.quality() << std::endl;
+            next_report = tuning.next_report(games_completed);
+        }
+    }
+
+    std::cout << "MAP-Elites: " << grid.size() << "/" << elite_grid::cells << " cells filled, quality "
+              << grid.quality() << std::endl;
+    if (!opt.elites_file.empty()) {
+        std::ofstream out(opt.elites_file);
+        grid.write(out);
+        std::cout << "Elites written to " << opt.elites_file << std::endl;
+    }
+    return games_completed;
+}
+
+// Deck positions for large-neighbourhood search to destroy, by heuristic:
+// random positions, a window of consecutive positions, or half face card and
+// half non-face positions so that the repair can move face cards around.
+// "mixed" picks one of the three at random.
+std::vector<int> pick_destroyed(const deck& d, int k, const std::string& heuristic, std::mt19937& rng) {
+    std::string h = heuristic;
+    if (h == "mixed") {
+        static const char* heuristics[] = {"random", "window", "faces"};
+        h = heuristics[std::uniform_int_distribution<>(0, 2)(rng)];
+    }
+    std::vector<int> positions(deck::size);
+    std::iota(positions.begin(), positions.end(), 0);
+    if (h == "window") {
+        int start = std::uniform_int_distribution<>(0, deck::size - 1)(rng);
+        std::vector<int> out;
+        for (int i = 0; i < k; ++i) out.push_back((start + i) % deck::size);
+        return out;
+    }
+    std::shuffle(positions.begin(), positions.end(), rng);
+    if (h == "faces") {
+        std::stable_partition(positions.begin(), positions.end(), [&](int p) { return d.cards[p] > 0; });
+        std::vector<int> out(positions.begin(), positions.begin() + (k + 1) / 2);
+        out.insert(out.end(), positions.end() - k / 2, positions.end());
+        return out;
+    }
+    positions.resize(k);
+    return positions;
+}
+
+// Large-neighbourhood search: destroy k positions of the current deck and
+// repair them with every arrangement of the removed cards (or a random sample
+// of them when there are more than --lns-samples), which keeps four of each
+// face card. All repairs share the game up to the last trick boundary before
+// the first destroyed position is played; it is simulated once and each repair
+// continues from a copy.
+// Repairs are evaluated in parallel and the best one becomes the current
+// deck if it is at least as long.
+long run_lns(const search_options& opt, ThreadPool& pool, leaderboard& board, result_checks& checks,
+             std::chrono::high_resolution_clock::time_point start_time) {
+    std::mt19937 rng(std::random_device{}());
+    deck current;
+    current.shuffle(rng);
+    if (!opt.lns_from.empty()) {
+        current = deck::from_string(opt.lns_from);
+    } else {
+        // Start from the longest game recorded in high_score.txt, if any
+        std::ifstream in("high_score.txt");
+        int best = 0;
+        for (std::string line; std::getline(in, line);) {
+            std::stringstream ss(line);
+            std::string score, tricks, winner, cards;
+            if (std::getline(ss, score, ',') && std::getline(ss, tricks, ',') && std::getline(ss, winner, ',') &&
+                std::getline(ss, cards, ',') && cards.size() == size_t(deck::size) && std::stoi(score) > best &&
+                deck::from_string(cards).is_valid()) {
+                best = std::stoi(score);
+                current = deck::from_string(cards);
+            }
+        }
+    }
+    game scorer;
+    scorer.start(current);
+    auto [start_winner, start_cards, start_tricks, start_key] = scorer.play();
+    int current_cards = start_winner > 0 ? start_cards : 0;
+    std::tuple<int, int, int, DeckKey> target_game{0, 0, 0, DeckKey{}};
+    board.offer(start_winner, start_cards, start_tricks);
+    std::cout << "LNS from " << current << ": " << current_cards << " cards" << std::endl;
+
+    long games_completed = 1;
+    long next_report = tuning.next_report(0);
+    long improvements = 0;
+    while (games_completed < opt.num_games) {
+        int k = tuning.lns_k;
+        long samples = tuning.lns_samples;
+        std::vector<int> destroyed = pick_destroyed(current, std::min(k, deck::size), opt.lns_destroy, rng);
+        std::vector<int> removed;
+        for (int p : destroyed) removed.push_back(current.cards[p]);
+        std::sort(removed.begin(), removed.end());
+        if (removed.front() == removed.back()) {
+            games_completed++;
+            continue; // every repair would be the same deck
+        }
+
+        // Every distinct arrangement if there are few enough, else a sample
+        std::vector<std::vector<int>> repairs;
+        std::vector<int> arrangement = removed;
+        do {
+            repairs.push_back(arrangement);
+        } while (long(repairs.size()) <= samples && std::next_permutation(arrangement.begin(), arrangement.end()));
+        if (long(repairs.size()) > samples) {
+            repairs.resize(samples);
+            for (auto& r : repairs) std::shuffle(r.begin(), r.end(), rng);
+        }
+        repairs.resize(std::min<size_t>(repairs.size(), size_t(opt.num_games - games_completed)));
+
+        std::vector<bool> open(deck::size, false);
+        for (int p : destroyed) open[p] = true;
+        game prefix;
+        prefix.start(current);
+        if (!prefix.advance_until(open)) {
+            games_completed++;
+            continue; // the destroyed positions are never played
+        }
+
+        int slices = std::max(1, std::min(int(pool.active_count()), int(repairs.size())));
+        std::vector<std::future<std::pair<std::tuple<int, int, int, DeckKey>, int>>> results;
+        for (int s = 0; s < slices; ++s) {
+            size_t begin = repairs.size() * s / slices, end = repairs.size() * (s + 1) / slices;
+            results.push_back(pool.enqueue([&, begin, end] {
+                std::pair<std::tuple<int, int, int, DeckKey>, int> best{{0, 0, 0, DeckKey{}}, -1};
+                for (size_t i = begin; i < end; ++i) {
+                    game g(prefix);
+                    for (size_t j = 0; j < destroyed.size(); ++j) g.refill(destroyed[j], repairs[i][j]);
+                    auto result = g.play();
+                    if (std::get<0>(result) > 0 && std::get<1>(result) > std::get<1>(best.first)) {
+                        best = {result, int(i)};
+                    }
+                }
+                return best;
+            }));
+        }
+
+        std::pair<std::tuple<int, int, int, DeckKey>, int> best{{0, 0, 0, DeckKey{}}, -1};
+        for (auto& result : results) {
+            auto r = result.get();
+            if (r.second >= 0 && std::get<1>(r.first) > std::get<1>(best.first)) best = r;
+        }
+        games_completed += long(repairs.size());
+
+        if (best.second >= 0) {
+            auto [winner, cards_played, tricks, game_deck] = best.first;
+            if (opt.target > 0 && cards_played > opt.target) {
+                target_game = best.first;
+            } else if (board.offer(winner, cards_played, tricks)) {
+                checks.record(winner, cards_played, tricks, game_deck, 1);
+            }
+            if (cards_played >= current_cards) {
+                improvements += cards_played > current_cards;
+                current = game_deck.to_deck();
+                current_cards = cards_played;
+            }
+        }
+        if (std::get<0>(target_game) > 0) {
+            auto [winner, cards_played, tricks, game_deck] = target_game;
+            board.offer(winner, cards_played, tricks);
+            checks.record(winner, cards_played, tricks, game_deck, 1, true);
+            print_target(opt.target, winner, cards_played, tricks, game_deck, 1, false,
+                         " after " + std::to_string(games_completed) + " games");
+            break;
+        }
+
+        if (games_completed >= next_report) {
+            print_rate(games_completed, start_time);
+            checks.report(false);
+            std::cout << "LNS: current deck " << current_cards << " cards, " << improvements << " improvements" << std::endl;
+            next_report = tuning.next_report(games_completed);
+        }
+    }
+    std::cout << "LNS: final deck " << current << ", " << current_cards << " cards" << std::endl;
+    return games_completed;
+}
+
+// Novelty search: instead of selecting for long games, keep decks whose games
+// behave unlike anything seen so far, and let record length fall out as a side
+// effect. Each generation mutates parents picked by novelty tournament, plays
+// the children in parallel with a behaviour trace, and scores them against the
+// archive. The archive is only changed between generations, so workers can
+// read it without locking. With a dedup filter, children that repeat an
+// already evaluated deal are mutated again (a few attempts) instead of replayed.
+long run_novelty_search(const search_options& opt, ThreadPool& pool, leaderboard& board, result_checks& checks,
+                        feature_collector* features, dedup_filter* seen, memory_budget::component* archive_memory,
+                        std::chrono::high_resolution_clock::time_point start_time) {
+    struct candidate {
+        deck d;
+        behaviour b;
+        double novelty = 0;
+    };
+
+    constexpr int nearest = 15;
+    std::mt19937 rng(std::random_device{}());
+    novelty_archive archive(rng);
+    if (archive_memory && archive_memory->granted > 0) {
+        archive.set_limit(archive_memory->granted);
+    }
+    double threshold = 0.1;
+    std::vector<candidate> population;
+    long games_completed = 0;
+    long next_report = tuning.next_report(0);
+    std::tuple<int, int, int, DeckKey> target_game{0, 0, 0, DeckKey{}};
+
+    while (games_completed < opt.num_games) {
+        int batch = int(std::min<long>(opt.population, opt.num_games - games_completed));
+
+        // The first generation is random; after that children mutate tournament winners
+        std::vector<deck> children(batch);
+        for (auto& child : children) {
+            if (population.empty()) {
+                child.shuffle(rng);
+                if (seen) seen->insert(DeckKey::from_deck(child));
+                continue;
+            }
+            std::uniform_int_distribution<size_t> pick(0, population.size() - 1);
+            const candidate& a = population[pick(rng)];
+            const candidate& b = population[pick(rng)];
+            const deck& parent = (a.novelty >= b.novelty ? a : b).d;
+            for (int attempt = 0; attempt < 8; ++attempt) {
+                child = parent;
+                child.mutate(rng, std::uniform_int_distribution<>(1, tuning.max_swaps)(rng));
+                if (!seen || seen->insert(DeckKey::from_deck(child))) break;
+            }
+        }
+
+        // Play and score the children in one slice per worker
+        int slices = std::max(1, std::min(int(pool.active_count()), batch));
+        std::vector<std::future<std::vector<std::pair<candidate, std::tuple<int, int, int, DeckKey>>>>> results;
+        for (int s = 0; s < slices; ++s) {
+            int begin = batch * s / slices, end = batch * (s + 1) / slices;
+            results.push_back(pool.enqueue([&, begin, end] {
+                std::vector<std::pair<candidate, std::tuple<int, int, int, DeckKey>>> out;
+                std::vector<behaviour> neighbours;
+                for (auto& p : population) neighbours.push_back(p.b);
+                game g;
+                for (int i = begin; i < end; ++i) {
+                    candidate c;
+                    c.d = children[i];
+                    g.set_trace(&c.b);
+                    g.start(c.d);
+                    auto result = g.play();
+                    if (features && std::get<0>(result) > 0) {
+                        features->add(std::get<3>(result), std::get<1>(result), 1);
+                    }
+                    c.novelty = archive.novelty(c.b, nearest, neighbours);
+                    out.emplace_back(std::move(c), result);
+                }
+                return out;
+            }));
+        }
+
+        std::vector<candidate> scored;
+        int added = 0;
+        for (auto& result : results) {
+            for (auto& [c, r] : result.get()) {
+                auto [winner, cards_played, tricks, game_deck] = r;
+                if (opt.target > 0 && winner > 0 && cards_played > opt.target) {
+                    if (cards_played > std::get<1>(target_game)) {
+                        target_game = r;
+                    }
+                } else if (board.offer(winner, cards_played, tricks)) {
+                    checks.record(winner, cards_played, tricks, game_deck, 1);
+                } else if (winner == -1) {
+                    checks.cycle(game_deck, 1);
+                }
+                if (c.novelty > threshold) {
+                    archive.add(c.b);
+                    added++;
+                }
+                scored.push_back(std::move(c));
+            }
+        }
+        games_completed += batch;
+        if (std::get<0>(target_game) > 0) {
+            auto [winner, cards_played, tricks, game_deck] = target_game;
+            board.offer(winner, cards_played, tricks);
+            checks.record(winner, cards_played, tricks, game_deck, 1, true);
+            print_target(opt.target, winner, cards_played, tricks, game_deck, 1, false,
+                         " after " + std::to_string(games_completed) + " games");
+            break;
+        }
+
+        // Keep the archive growing at a steady pace
+        if (added > batch / 10) {
+            threshold *= 1.05;
+        } else if (added == 0) {
+            threshold *= 0.95;
+        }
+
+        // The most novel of parents and children survive
+        for (auto& p : population) scored.push_back(std::move(p));
+        size_t keep = std::min(scored.size(), size_t(opt.population));
+        std::partial_sort(scored.begin(), scored.begin() + keep, scored.end(),
+                          [](const candidate& a, const candidate& b) { return a.novelty > b.novelty; });
+        scored.resize(keep);
+        population = std::move(scored);
+        if (archive_memory) {
+            archive_memory->set_used(archive.bytes());
+        }
+
+        if (games_completed >= next_report) {
+            print_rate(games_completed, start_time);
+            checks.report(false);
+            std::cout << "Novelty archive: " << archive.size() << " behaviours, threshold " << threshold << std::endl;
+            next_report = tuning.next_report(games_completed);
+        }
+    }
+    return games_completed;
+}
+
+// Probe throughput of a dedup_filter filled to half load, for each page mode
+void run_table_bench(const search_options& opt) {
+    const page_mode modes[] = {page_mode::normal, page_mode::transparent, page_mode::huge_2m, page_mode::huge_1g};
+    for (page_mode want : modes) {
+        auto alloc_start = std::chrono::high_resolution_clock::now();
+        dedup_filter filter(opt.table_bench_bytes, want, opt.numa_interleave, opt.num_threads);
+        auto alloc_end = std::chrono::high_resolution_clock::now();
+        if (filter.pages() != want) {
+            std::cout << page_mode_name(want) << ": not available, skipped" << std::endl;
+            continue;
+        }
+
+        // Fill with random keys, then probe a mix of present and absent keys
+        size_t keys = filter.capacity() / 2;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < opt.num_threads; ++t) {
+            threads.emplace_back([&, t] {
+                std::mt19937_64 rng(t + 1);
+                for (size_t i = t; i < keys; i += opt.num_threads) filter.insert({rng(), rng()});
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        threads.clear();
+
+        const size_t probes_per_thread = 1 << 22;
+        std::atomic<size_t> hits{0};
+        auto probe_start = std::chrono::high_resolution_clock::now();
+        for (int t = 0; t < opt.num_threads; ++t) {
+            threads.emplace_back([&, t] {
+                std::mt19937_64 rng(t + 1000);
+                size_t local_hits = 0;
+                for (size_t i = 0; i < probes_per_thread; ++i) local_hits += filter.contains({rng(), rng()});
+                hits += local_hits;
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        auto probe_end = std::chrono::high_resolution_clock::now();
+
+        double seconds = std::chrono::duration<double>(probe_end - probe_start).count();
+        std::cout << page_mode_name(want) << ": " << (filter.capacity() * 8 >> 20) << " MB, "
+                  << "allocate+prefault " << std::chrono::duration_cast<std::chrono::milliseconds>(alloc_end - alloc_start).count() << " ms, "
+                  << (probes_per_thread * opt.num_threads / seconds / 1e6) << " M probes/s" << std::endl;
+    }
+}
+
+// Reduce the same buffer of deals on the thread pool and with std::execution,
+// a few rounds each, and check that both backends agree
+void run_backend_bench(const search_options& opt, ThreadPool& pool) {
+    std::mt19937 rng(12345);
+    std::vector<deck> decks(size_t(opt.backend_bench_deals));
+    for (auto& d : decks) d.shuffle(rng);
+
+    constexpr int rounds = 3;
+    batch_summary results[2];
+    for (int backend = 0; backend < 2; ++backend) {
+        std::vector<double> seconds;
+        for (int r = 0; r < rounds; ++r) {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            results[backend] = backend == 0
+                ? reduce_pool(pool, opt.num_threads, decks, decks.size(), opt.variants, nullptr)
+                : reduce_std(decks, decks.size(), opt.variants, nullptr);
+            auto t1 = std::chrono::high_resolution_clock::now();
+            seconds.push_back(std::chrono::duration<double>(t1 - t0).count());
+        }
+        double best = *std::min_element(seconds.begin(), seconds.end());
+        std::cout << (backend == 0 ? "thread pool:     " : "std::execution:  ") << best * 1000 << " ms best of "
+                  << rounds << ", " << (results[backend].games / best) << " games/s" << std::endl;
+    }
+    std::cout << "Longest game: " << results[0].cards_played << " cards; backends "
+              << (results[0] == results[1] ? "agree" : "DISAGREE") << std::endl;
+    results[1].print(std::cout);
+}
+
+// Hardware counter of this thread in user space, if the kernel and the
+// machine provide one
+class perf_counter {
+private:
+    int fd = -1;
+
+public:
+    perf_counter(uint32_t type, uint64_t config) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~perf_counter() {
+        if (fd >= 0) close(fd);
+    }
+    perf_counter(const perf_counter&) = delete;
+    perf_counter& operator=(const perf_counter&) = delete;
+
+    bool available() const { return fd >= 0; }
+    void start() {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    uint64_t stop() {
+        uint64_t value = 0;
+        if (fd < 0) return 0;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        return read(fd, &value, sizeof(value)) == ssize_t(sizeof(value)) ? value : 0;
+    }
+};
+
+// Single-threaded engine throughput on a fixed set of deals: moves per second,
+// and cache misses per thousand moves where hardware counters are available
+void run_engine_bench(const search_options& opt) {
+    std::mt19937 rng(12345);
+    std::vector<deck> decks(size_t(opt.engine_bench_deals));
+    for (auto& d : decks) d.shuffle(rng);
+
+    perf_counter misses(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    perf_counter l1_misses(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    if (!misses.available() && !l1_misses.available()) {
+        std::cout << "Cache misses: hardware counters not available" << std::endl;
+    }
+
+    // The card engine first, then the trick engine, which must play the same games
+    constexpr int rounds = 3;
+    long totals[2][2] = {};
+    for (int engine = 0; engine < 2; ++engine) {
+        double best = 0;
+        uint64_t best_misses = 0, best_l1_misses = 0;
+        long moves = 0, tricks = 0;
+        for (int r = 0; r < rounds; ++r) {
+            game g;
+            g.set_trick_engine(engine == 1);
+            moves = tricks = 0;
+            misses.start();
+            l1_misses.start();
+            auto t0 = std::chrono::high_resolution_clock::now();
+            for (auto& d : decks) {
+                g.start(d);
+                auto result = g.play();
+                moves += std::get<1>(result);
+                tricks += std::get<2>(result);
+            }
+            auto t1 = std::chrono::high_resolution_clock::now();
+            uint64_t m = misses.stop(), l1 = l1_misses.stop();
+            double seconds = std::chrono::duration<double>(t1 - t0).count();
+            if (r == 0 || seconds < best) {
+                best = seconds;
+                best_misses = m;
+                best_l1_misses = l1;
+            }
+        }
+        totals[engine][0] = moves;
+        totals[engine][1] = tricks;
+        std::cout << (engine == 0 ? "card engine:  " : "trick engine: ") << decks.size() << " games, " << moves
+                  << " moves, " << tricks << " tricks: " << best * 1000 << " ms best of " << rounds << ", "
+                  << (moves / best / 1e6) << " M moves/s" << std::endl;
+        if (misses.available()) {
+            std::cout << "  cache misses: " << best_misses * 1000.0 / moves << " per 1000 moves" << std::endl;
+        }
+        if (l1_misses.available()) {
+            std::cout << "  L1D read misses: " << best_l1_misses * 1000.0 / moves << " per 1000 moves" << std::endl;
+        }
+    }
+    const trick_memo& memo = trick_memo::local();
+    std::cout << "Trick memo: " << memo.hits << " hits, " << memo.misses << " misses; engines "
+              << (totals[0][0] == totals[1][0] && totals[0][1] == totals[1][1] ? "agree" : "DISAGREE") << std::endl;
+}
+
+// Local control socket for retuning a running search. Every connection sends
+// lines of text:
+//
+//   get                 current values of all settings
+//   set <name> <value>  change a setting of search_tuning, or `threads`
+//
+// and gets one reply line per command. `threads` sets the pool's worker count,
+// which the std backend does not use. Changes are acknowledged on the socket
+// and in the log.
+class control_channel {
+private:
+    std::string path;
+    ThreadPool& pool;
+    bool pool_search; // the running search plays its games on `pool`
+    std::atomic<size_t> threads;
+    int listen_fd = -1;
+    std::atomic<bool> stop{false};
+    std::thread listener;
+
+    std::string values() const {
+        std::ostringstream out;
+        out << "progress " << tuning.progress_interval << " mutation " << tuning.max_swaps
+            << " bias-strength " << tuning.bias_strength << " bias-interval " << tuning.bias_interval
+            << " lns-k " << tuning.lns_k << " lns-samples " << tuning.lns_samples << " threads " << threads;
+        return out.str();
+    }
+
+    std::string apply(const std::string& name, const std::string& value) {
+        try {
+            if (name == "progress") {
+                tuning.progress_interval = std::max(1L, std::stol(value));
+            } else if (name == "mutation") {
+                tuning.max_swaps = std::clamp(std::stoi(value), 1, deck::size / 2);
+            } else if (name == "bias-strength") {
+                tuning.bias_strength = std::stod(value);
+            } else if (name == "bias-interval") {
+                tuning.bias_interval = std::max(1L, std::stol(value));
+            } else if (name == "lns-k") {
+                tuning.lns_k = std::clamp(std::stoi(value), 2, deck::size);
+            } else if (name == "lns-samples") {
+                tuning.lns_samples = std::max(1L, std::stol(value));
+            } else if (name == "threads") {
+                if (!pool_search) {
+                    return "error threads has no effect on the std backend";
+                }
+                // Workers are started on demand, so keep the count sane
+                int limit = std::max(4, 4 * int(std::thread::hardware_concurrency()));
+                threads = size_t(std::clamp(std::stoi(value), 1, limit));
+                pool.set_active(threads);
+            } else {
+                return "error unknown setting " + name;
+            }
+        } catch (const std::exception&) {
+            return "error bad value " + value;
+        }
+        std::string ack = "ok " + values();
+        // Values are clamped, so log what was applied rather than what was asked
+        std::cout << ("Control: set " + name + " " + value + "; now " + values() + "\n") << std::flush;
+        return ack;
+    }
+
+    std::string command(const std::string& line) {
+        std::istringstream in(line);
+        std::string verb, name, value;
+        in >> verb >> name >> value;
+        if (verb == "get") {
+            return values();
+        }
+        if (verb == "set" && !value.empty()) {
+            return apply(name, value);
+        }
+        return "error usage: get | set <name> <value>";
+    }
+
+    void serve(int fd) {
+        std::string buffer;
+        char chunk[256];
+        while (!stop) {
+            pollfd p{fd, POLLIN, 0};
+            if (poll(&p, 1, 200) <= 0) continue;
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n <= 0) break;
+            buffer.append(chunk, size_t(n));
+            for (size_t end; (end = buffer.find('\n')) != std::string::npos;) {
+                std::string reply = command(buffer.substr(0, end)) + "\n";
+                buffer.erase(0, end + 1);
+                // A client that hung up must not take the search down with SIGPIPE
+                if (send(fd, reply.data(), reply.size(), MSG_NOSIGNAL) != ssize_t(reply.size())) break;
+            }
+        }
+        close(fd);
+    }
+
+public:
+    control_channel(const std::string& path, ThreadPool& pool, size_t num_threads, bool pool_search)
+        : path(path), pool(pool), pool_search(pool_search), threads(num_threads) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("control socket path too long: " + path);
+        }
+        std::copy(path.begin(), path.end(), addr.sun_path);
+        unlink(path.c_str());
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(listen_fd, 4) != 0) {
+            if (listen_fd >= 0) close(listen_fd);
+            throw std::runtime_error("cannot listen on control socket " + path);
+        }
+        // One connection at a time; the listener checks for shutdown between polls
+        listener = std::thread([this] {
+            while (!stop) {
+                pollfd p{listen_fd, POLLIN, 0};
+                if (poll(&p, 1, 200) <= 0) continue;
+                int fd = accept(listen_fd, nullptr, nullptr);
+                if (fd >= 0) serve(fd);
+            }
+        });
+    }
+
+    ~control_channel() {
+        stop = true;
+        listener.join();
+        close(listen_fd);
+        unlink(path.c_str());
+    }
+};
+
+int main(int argc, char* argv[]) {
+    search_options opt;
+    
+    // Parse command line arguments: [num_games] [num_threads] [high_score] [options]
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--variants") {
+            opt.variants = true;
+        } else if (arg == "--novelty") {
+            opt.novelty = true;
+        } else if (arg == "--lns") {
+            opt.lns = true;
+        } else if (arg == "--lns-k" && has_value) {
+            opt.lns_k = std::max(2, std::stoi(argv[++i]));
+        } else if (arg == "--lns-destroy" && has_value) {
+            opt.lns_destroy = argv[++i];
+        } else if (arg == "--lns-samples" && has_value) {
+            opt.lns_samples = std::max(1L, std::stol(argv[++i]));
+        } else if (arg == "--lns-from" && has_value) {
+            opt.lns_from = argv[++i];
+        } else if (arg == "--map-elites") {
+            opt.map_elites = true;
+        } else if (arg == "--elites" && has_value) {
+            opt.elites_file = argv[++i];
+        } else if (arg == "--population" && has_value) {
+            opt.population = std::max(2, std::stoi(argv[++i]));
+        } else if (arg == "--features" && has_value) {
+            opt.features_file = argv[++i];
+        } else if (arg == "--bias") {
+            opt.bias = true;
+        } else if (arg == "--bias-strength" && has_value) {
+            opt.bias_strength = std::stod(argv[++i]);
+        } else if (arg == "--bias-interval" && has_value) {
+            opt.bias_interval = std::max(1L, std::stol(argv[++i]));
+        } else if (arg == "--dynamics" && has_value) {
+            opt.dynamics_file = argv[++i];
+        } else if (arg == "--dynamics-sample" && has_value) {
+            opt.dynamics_sample = std::max(1L, std::stol(argv[++i]));
+        } else if (arg == "--target" && has_value) {
+            opt.target = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--control" && has_value) {
+            opt.control_path = argv[++i];
+        } else if (arg == "--dedup-mb" && has_value) {
+            opt.dedup_bytes = std::stoull(argv[++i]) << 20;
+        } else if (arg == "--hugepages" && has_value) {
+            std::string mode = argv[++i];
+            opt.pages = mode == "1g" ? page_mode::huge_1g : mode == "2m" ? page_mode::huge_2m
+                      : mode == "off" ? page_mode::normal : page_mode::transparent;
+        } else if (arg == "--tablebase" && has_value) {
+            opt.tablebase_file = argv[++i];
+        } else if (arg == "--numa-interleave") {
+            opt.numa_interleave = true;
+        } else if (arg == "--table-bench" && has_value) {
+            opt.table_bench_bytes = std::stoull(argv[++i]) << 20;
+        } else if (arg == "--memory-mb" && has_value) {
+            opt.memory_bytes = std::stoull(argv[++i]) << 20;
+        } else if (arg == "--backend" && has_value) {
+            opt.std_backend = std::string(argv[++i]) == "std";
+        } else if (arg == "--backend-bench" && has_value) {
+            opt.backend_bench_deals = std::max(1L, std::stol(argv[++i]));
+        } else if (arg == "--engine-bench" && has_value) {
+            opt.engine_bench_deals = std::max(1L, std::stol(argv[++i]));
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() > 0) {
+        opt.num_games = std::stoi(positional[0]);
+    }
+    if (positional.size() > 1) {
+        opt.num_threads = std::stoi(positional[1]);
+    }
+    if (positional.size() > 2) {
+        opt.high_score = std::stoi(positional[2]);
+    }
+
+    if (opt.dedup_bytes > 0 && !opt.novelty && !(opt.map_elites && !opt.lns)) {
+        // Random deals practically never repeat, and LNS repairs are distinct
+        std::cerr << "Warning: --dedup-mb only applies to --novelty and --map-elites; ignored" << std::endl;
+        opt.dedup_bytes = 0;
+    }
+    if (!opt.dynamics_file.empty() && (opt.std_backend || opt.novelty || opt.map_elites || opt.lns)) {
+        std::cerr << "Error: --dynamics profiles the random search only; it cannot be combined with "
+                  << "--backend std, --novelty, --map-elites or --lns." << std::endl;
+        return 1;
+    }
+    if (opt.variants && (opt.novelty || opt.map_elites || opt.lns)) {
+        // Those searches always deal to player 1, so leaderboard lines would carry a meaningless start field
+        std::cerr << "Error: --variants only applies to the random search; it cannot be combined with "
+                  << "--novelty, --map-elites or --lns." << std::endl;
+        return 1;
+    }
+    if (!opt.lns_from.empty() &&
+        (opt.lns_from.size() != size_t(deck::size) || !deck::from_string(opt.lns_from).is_valid())) {
+        std::cerr << "Error: Invalid deck for --lns-from." << std::endl;
+        std::cerr << "A valid deck must have exactly 4 of each face card (J,Q,K,A) and a total of 52 cards." << std::endl;
+        return 1;
+    }
+
+    tuning.bias_strength = opt.bias_strength;
+    tuning.bias_interval = opt.bias_interval;
+    tuning.lns_k = opt.lns_k;
+    tuning.lns_samples = opt.lns_samples;
+
+    if (opt.table_bench_bytes > 0) {
+        run_table_bench(opt);
+        return 0;
+    }
+    if (opt.engine_bench_deals > 0) {
+        run_engine_bench(opt);
+        return 0;
+    }
+    if (opt.backend_bench_deals > 0) {
+        ThreadPool pool(opt.num_threads);
+        run_backend_bench(opt, pool);
+        return 0;
+    }
+    
+    std::cout << "Running " << opt.num_games << (opt.variants ? " deals" : " games")
+              << " with " << opt.num_threads << " threads";
+    if (opt.novelty) {
+        std::cout << " (novelty search, population " << opt.population << ")";
+    } else if (opt.lns) {
+        std::cout << " (large-neighbourhood search, k=" << opt.lns_k << ", " << opt.lns_destroy << " destroy)";
+    } else if (opt.map_elites) {
+        std::cout << " (MAP-Elites, " << elite_grid::cells << " cells)";
+    } else if (opt.std_backend) {
+        std::cout << " (std::execution backend)";
+    }
+    std::cout << "\n";
+    
+    std::ofstream file("high_score.txt", std::ios_base::app);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file 'high_score.txt'" << std::endl;
+        return 1;
+    }
+
+    ThreadPool pool(opt.num_threads);
+    leaderboard board(file, opt.high_score, opt.variants);
+
+    std::unique_ptr<control_channel> control;
+    if (!opt.control_path.empty()) {
+        try {
+            control.reset(new control_channel(opt.control_path, pool, opt.num_threads,
+                                              !opt.std_backend || opt.novelty || opt.map_elites || opt.lns));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        std::cout << "Control socket: " << opt.control_path << std::endl;
+    }
+
+    // Positional statistics are only collected when they are dumped or fed back
+    std::unique_ptr<feature_collector> features;
+    if (!opt.features_file.empty() || opt.bias) {
+        features.reset(new feature_collector);
+    }
+
+    // Game dynamics are profiled on a sample of the random search's games
+    std::unique_ptr<dynamics_collector> dynamics;
+    if (!opt.dynamics_file.empty()) {
+        dynamics.reset(new dynamics_collector(opt.dynamics_sample));
+    }
+
+    std::unique_ptr<endgame_tablebase> tablebase;
+    if (!opt.tablebase_file.empty()) {
+        try {
+            tablebase.reset(new endgame_tablebase(opt.tablebase_file));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        endgame_table = tablebase.get();
+        std::cout << "Endgame tablebase: hands of up to " << tablebase->small_limit() << " cards, window "
+                  << tablebase->window_size() << std::endl;
+    }
+
+    // Every cache that is in use gets its share of --memory-mb. The tablebase is
+    // a read-only file mapping and is only reported.
+    memory_budget budget(opt.memory_bytes);
+    memory_budget::component* dedup_memory = opt.dedup_bytes > 0 ? budget.add("dedup filter", 4) : nullptr;
+    memory_budget::component* archive_memory = opt.novelty ? budget.add("novelty archive", 2) : nullptr;
+    memory_budget::component* queue_memory = !opt.novelty && !opt.map_elites && !opt.lns ? budget.add(opt.std_backend ? "deal buffer" : "result queue", 1) : nullptr;
+    if (tablebase) {
+        budget.add("tablebase", 0)->set_used(tablebase->bytes());
+    }
+    // Workers read MAP-Elites elites without locks, so a replaced elite is only
+    // freed with the grid and the grid cannot evict to fit a grant. It grows by
+    // one elite per improvement of a cell and is only reported.
+    memory_budget::component* grid_memory = opt.map_elites ? budget.add("MAP-Elites grid", 0) : nullptr;
+    budget.distribute();
+
+    // Large shared tables are allocated and pre-faulted before the clock starts
+    std::unique_ptr<dedup_filter> seen;
+    if (dedup_memory) {
+        size_t bytes = dedup_memory->granted > 0 ? std::min(opt.dedup_bytes, dedup_memory->granted) : opt.dedup_bytes;
+        seen.reset(new dedup_filter(bytes, opt.pages, opt.numa_interleave, opt.num_threads));
+        dedup_memory->set_used(seen->bytes());
+        std::cout << "Dedup filter: " << seen->capacity() << " slots on " << page_mode_name(seen->pages()) << std::endl;
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    result_checks checks(pool, board);
+    long games_completed = opt.novelty
+        ? run_novelty_search(opt, pool, board, checks, features.get(), seen.get(), archive_memory, start_time)
+        : opt.lns ? run_lns(opt, pool, board, checks, start_time)
+        : opt.map_elites ? run_map_elites(opt, pool, board, checks, features.get(), seen.get(), grid_memory, start_time)
+        : opt.std_backend ? run_std_search(opt, board, checks, features.get(), queue_memory, start_time)
+        : run_random_search(opt, pool, board, checks, features.get(), dynamics.get(), queue_memory, start_time);
+    checks.report(true);
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time).count();
+    
+    std::cout << "Completed " << games_completed << " games in " << duration << " seconds" << std::endl;
+    std::cout << "Games per second: " << (games_completed / (duration + 0.1)) << std::endl;
+    std::cout << "Highest score: " << board.high_score << std::endl;
+    pool.print_latency(std::cout);
+    if (seen) {
+        std::cout << "Dedup filter: " << seen->size() << " deals recorded, " << seen->evicted() << " evicted" << std::endl;
+    }
+    budget.report(std::cout);
+
+    if (features && !opt.features_file.empty()) {
+        std::ofstream out(opt.features_file);
+        features->merged()->dump(out);
+        std::cout << "Feature statistics written to " << opt.features_file << std::endl;
+    }
+    if (dynamics) {
+        auto profile = dynamics->merged();
+        if (opt.dynamics_file == "-") {
+            profile->print(std::cout);
+        } else {
+            std::ofstream out(opt.dynamics_file);
+            profile->print(out);
+            std::cout << "Game dynamics of " << profile->games << " sampled games written to " << opt.dynamics_file << std::endl;
+        }
+    }
 
     file.close();
     return 0;
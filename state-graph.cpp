@@ -0,0 +1,523 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Builds the graph of trick-boundary states reached by many random deals.
+//
+// A node is a position with an empty pile and no penalty running, i.e. the start
+// of a game or the moment after a trick was picked up. It is keyed by a 64-bit
+// fingerprint of both hands and the player to move. The game is deterministic, so
+// every node has exactly one successor: the next trick boundary, or the end of the
+// game. Once a worker reaches a node that is already known, the remaining path is
+// known too, and the worker stops that game.
+
+// Card representation: 0=non-face card, 1=J, 2=Q, 3=K, 4=A
+struct deck {
+    static constexpr int size = 52;
+    std::vector<int> cards;
+
+    deck() : cards(size, 0) {}
+
+    void shuffle(std::mt19937& rng) {
+        std::fill(cards.begin(), cards.end(), 0);
+        // Place face cards (4 of each type)
+        for (int card = 1; card <= 4; ++card) {
+            for (int iter = 0; iter < 4; ++iter) {
+                int pos;
+                do {
+                    pos = std::uniform_int_distribution<>(0, size - 1)(rng);
+                } while (cards[pos] != 0);
+                cards[pos] = card;
+            }
+        }
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const deck& d) {
+        for (auto i : d.cards) {
+            char c;
+            switch (i) {
+                case 1: c = 'J'; break;
+                case 2: c = 'Q'; break;
+                case 3: c = 'K'; break;
+                case 4: c = 'A'; break;
+                default: c = '-';
+            }
+            os << c;
+        }
+        return os;
+    }
+};
+
+// Deal `index` of a run is reproducible from the run seed alone
+deck make_deal(uint64_t seed, uint64_t index) {
+    std::seed_seq seq{uint32_t(seed), uint32_t(seed >> 32), uint32_t(index), uint32_t(index >> 32)};
+    std::mt19937 rng(seq);
+    deck d;
+    d.shuffle(rng);
+    return d;
+}
+
+// Successor of the last trick boundary of a finished game. Never a real fingerprint.
+constexpr uint64_t TERMINAL = 0;
+
+// Game engine that stops at trick boundaries. Rules are the ones in main-imp.cpp.
+struct trick_walker {
+    std::deque<int> hands[2];
+    std::vector<int> pile;
+    int active = 0;
+
+    void start(const deck& d) {
+        hands[0].assign(d.cards.begin(), d.cards.begin() + deck::size / 2);
+        hands[1].assign(d.cards.begin() + deck::size / 2, d.cards.end());
+        pile.clear();
+        active = 0;
+    }
+
+    bool is_game_over() const {
+        return hands[0].empty() || hands[1].empty();
+    }
+
+    uint64_t fingerprint() const {
+        uint64_t h = 0x9e3779b97f4a7c15ULL ^ uint64_t(active);
+        for (int p = 0; p < 2; ++p) {
+            h = (h ^ (0x100 + hands[p].size())) * 0x100000001b3ULL;
+            for (int card : hands[p]) {
+                h = (h ^ uint64_t(card)) * 0x100000001b3ULL;
+            }
+        }
+        h ^= h >> 31;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 29;
+        return h != TERMINAL ? h : 1;
+    }
+
+    // Play until the next trick is picked up or the game ends. Returns the moves played.
+    int next_trick() {
+        int moves = 0;
+        int remaining_penalties = 0;
+        bool face_card_active = false;
+        while (!is_game_over()) {
+            int card = hands[active].front();
+            hands[active].pop_front();
+            pile.push_back(card);
+            moves++;
+            if (card > 0) {
+                face_card_active = true;
+                remaining_penalties = card;
+                active ^= 1;
+            } else if (face_card_active) {
+                if (--remaining_penalties == 0) {
+                    hands[active].insert(hands[active].end(), pile.begin(), pile.end());
+                    pile.clear();
+                    return moves;
+                }
+                active ^= 1;
+            } else {
+                active ^= 1;
+            }
+        }
+        return moves;
+    }
+};
+
+// One edge of the graph: node `fp` continues to node `succ` after `moves` cards.
+// `origin` is the index of a deal that passes through the node.
+struct edge {
+    uint64_t fp;
+    uint64_t succ;
+    uint32_t moves;
+    uint64_t origin;
+};
+
+// Lock-free open addressing set of fingerprints, used to stop games that merge
+// into already explored territory. When it fills up, games simply run to the end.
+class visited_set {
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    size_t mask;
+    std::atomic<size_t> count{0};
+
+public:
+    explicit visited_set(size_t bytes) {
+        size_t capacity = 1024;
+        while (capacity * 2 * sizeof(uint64_t) <= bytes) capacity *= 2;
+        slots.reset(new std::atomic<uint64_t>[capacity]);
+        for (size_t i = 0; i < capacity; ++i) slots[i].store(0, std::memory_order_relaxed);
+        mask = capacity - 1;
+    }
+
+    bool full() const {
+        return count.load(std::memory_order_relaxed) * 4 > mask * 3;
+    }
+
+    // Returns true if `fp` was newly inserted, false if it was present (or the set is full)
+    bool insert(uint64_t fp, bool& present) {
+        present = false;
+        for (size_t i = fp & mask;; i = (i + 1) & mask) {
+            uint64_t cur = slots[i].load(std::memory_order_relaxed);
+            if (cur == fp) {
+                present = true;
+                return false;
+            }
+            if (cur == 0) {
+                if (full()) return false;
+                if (slots[i].compare_exchange_strong(cur, fp, std::memory_order_relaxed)) {
+                    count.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                if (cur == fp) {
+                    present = true;
+                    return false;
+                }
+            }
+        }
+    }
+
+    size_t size() const { return count.load(); }
+};
+
+// Writes sorted runs of edges to temporary files so memory stays bounded
+class run_writer {
+private:
+    std::string base;
+    std::mutex mutex;
+    std::vector<std::string> files;
+
+public:
+    explicit run_writer(std::string base) : base(std::move(base)) {}
+
+    void flush(std::vector<edge>& buffer) {
+        if (buffer.empty()) return;
+        std::sort(buffer.begin(), buffer.end(), [](const edge& a, const edge& b) { return a.fp < b.fp; });
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            name = base + ".run" + std::to_string(files.size());
+            files.push_back(name);
+        }
+        std::ofstream out(name, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(edge));
+        buffer.clear();
+    }
+
+    const std::vector<std::string>& runs() const { return files; }
+};
+
+void put_varint(std::ostream& os, uint64_t v) {
+    while (v >= 0x80) {
+        os.put(char(v | 0x80));
+        v >>= 7;
+    }
+    os.put(char(v));
+}
+
+uint64_t get_varint(std::istream& is) {
+    uint64_t v = 0;
+    for (int shift = 0;; shift += 7) {
+        int c = is.get();
+        if (c == EOF) throw std::runtime_error("truncated graph file");
+        v |= uint64_t(c & 0x7f) << shift;
+        if (!(c & 0x80)) return v;
+    }
+}
+
+void put_u64(std::ostream& os, uint64_t v) {
+    for (int i = 0; i < 8; ++i) os.put(char(v >> (8 * i)));
+}
+
+uint64_t get_u64(std::istream& is) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= uint64_t(uint8_t(is.get())) << (8 * i);
+    return v;
+}
+
+const char graph_magic[8] = {'B', 'M', 'N', 'S', 'G', '1', 0, 0};
+
+// K-way merge of the sorted runs into the final graph file, dropping duplicate
+// nodes. Nodes are stored in fingerprint order as varint deltas, followed by
+// the successor fingerprint, the move count and the origin deal.
+size_t merge_runs(const std::vector<std::string>& runs, const std::string& out_name) {
+    struct source {
+        std::ifstream in;
+        edge current;
+        bool next() {
+            return bool(in.read(reinterpret_cast<char*>(&current), sizeof(edge)));
+        }
+    };
+    std::vector<std::unique_ptr<source>> sources;
+    auto later = [&](size_t a, size_t b) { return sources[a]->current.fp > sources[b]->current.fp; };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heads(later);
+    for (auto& name : runs) {
+        sources.emplace_back(new source{std::ifstream(name, std::ios::binary), {}});
+        if (sources.back()->next()) heads.push(sources.size() - 1);
+    }
+
+    std::ofstream out(out_name, std::ios::binary);
+    out.write(graph_magic, sizeof(graph_magic));
+    auto count_pos = out.tellp();
+    put_u64(out, 0);
+
+    size_t nodes = 0;
+    uint64_t prev = 0;
+    bool first = true;
+    while (!heads.empty()) {
+        size_t i = heads.top();
+        heads.pop();
+        const edge& e = sources[i]->current;
+        if (first || e.fp != prev) {
+            put_varint(out, e.fp - prev);
+            put_u64(out, e.succ);
+            put_varint(out, e.moves);
+            put_varint(out, e.origin);
+            prev = e.fp;
+            first = false;
+            nodes++;
+        }
+        if (sources[i]->next()) heads.push(i);
+    }
+    out.seekp(count_pos);
+    put_u64(out, nodes);
+    for (auto& name : runs) std::remove(name.c_str());
+    return nodes;
+}
+
+struct build_options {
+    long num_games = 100000;
+    int num_threads = 1;
+    uint64_t seed = 1;
+    size_t table_bytes = size_t(1) << 30;
+    size_t run_edges = size_t(1) << 20;
+    std::string out = "state-graph.bin";
+};
+
+void build(const build_options& opt) {
+    visited_set visited(opt.table_bytes);
+    run_writer writer(opt.out);
+    std::atomic<long> next_game{0};
+    std::atomic<long> merged{0}, cycles{0};
+
+    auto worker = [&] {
+        std::vector<edge> buffer;
+        buffer.reserve(opt.run_edges);
+        trick_walker w;
+        std::unordered_set<uint64_t> own; // per-game fallback once the shared set is full
+        for (long g; (g = next_game.fetch_add(1)) < opt.num_games;) {
+            w.start(make_deal(opt.seed, g));
+            own.clear();
+            uint64_t fp = w.fingerprint();
+            while (true) {
+                bool present;
+                if (!visited.insert(fp, present)) {
+                    if (present) {
+                        merged++;
+                        break;
+                    }
+                    if (!own.insert(fp).second) {
+                        // Repeated trick boundary without the shared set: close the cycle
+                        cycles++;
+                        break;
+                    }
+                }
+                int moves = w.next_trick();
+                uint64_t succ = w.is_game_over() ? TERMINAL : w.fingerprint();
+                buffer.push_back({fp, succ, uint32_t(moves), uint64_t(g)});
+                if (buffer.size() >= opt.run_edges) writer.flush(buffer);
+                if (succ == TERMINAL) break;
+                fp = succ;
+            }
+        }
+        writer.flush(buffer);
+    };
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < opt.num_threads; ++i) threads.emplace_back(worker);
+    for (auto& t : threads) t.join();
+    auto sim_time = std::chrono::high_resolution_clock::now();
+
+    size_t nodes = merge_runs(writer.runs(), opt.out);
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    std::cout << "Simulated " << opt.num_games << " games in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(sim_time - start_time).count() << " ms, "
+              << merged << " merged into known states";
+    if (cycles > 0) std::cout << ", " << cycles << " cycles without shared table";
+    std::cout << std::endl;
+    std::cout << "Wrote " << nodes << " nodes to " << opt.out << " in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - sim_time).count() << " ms" << std::endl;
+}
+
+// Run `fn(begin, end)` over [0, n) split across threads
+template<typename F>
+void parallel_for(size_t n, int num_threads, F fn) {
+    std::vector<std::thread> threads;
+    size_t chunk = (n + num_threads - 1) / num_threads;
+    for (int t = 0; t < num_threads; ++t) {
+        size_t begin = std::min(n, t * chunk), end = std::min(n, begin + chunk);
+        threads.emplace_back(fn, begin, end);
+    }
+    for (auto& t : threads) t.join();
+}
+
+void analyse(const std::string& name, int num_threads, uint64_t seed, int top) {
+    std::ifstream in(name, std::ios::binary);
+    char magic[8];
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + 8, graph_magic)) {
+        throw std::runtime_error("not a state graph file: " + name);
+    }
+    size_t n = get_u64(in);
+    std::vector<uint64_t> fps(n), succ_fp(n);
+    std::vector<uint32_t> moves(n);
+    std::vector<uint64_t> origin(n);
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        fps[i] = prev + get_varint(in);
+        succ_fp[i] = get_u64(in);
+        moves[i] = uint32_t(get_varint(in));
+        origin[i] = get_varint(in);
+        prev = fps[i];
+    }
+
+    // Resolve successors to node indices; `n` stands for the terminal state
+    const int64_t none = int64_t(n);
+    std::vector<int64_t> next(n);
+    std::vector<std::atomic<uint32_t>> in_degree(n);
+    for (auto& d : in_degree) d.store(0, std::memory_order_relaxed);
+    std::atomic<bool> dangling(false);
+    parallel_for(n, num_threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (succ_fp[i] == TERMINAL) {
+                next[i] = none;
+                continue;
+            }
+            next[i] = std::lower_bound(fps.begin(), fps.end(), succ_fp[i]) - fps.begin();
+            if (next[i] == none || fps[next[i]] != succ_fp[i]) {
+                // Worker threads cannot throw; report once all have joined
+                dangling.store(true, std::memory_order_relaxed);
+                next[i] = none;
+                continue;
+            }
+            in_degree[next[i]].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    if (dangling) throw std::runtime_error("corrupt state graph file: successor missing from " + name);
+
+    // Remaining length by pointer jumping: after ceil(log2 n) rounds every node that
+    // reaches the terminal has summed its whole path. Nodes still pointing elsewhere
+    // lead into a cycle and never finish.
+    std::vector<int64_t> remaining(moves.begin(), moves.end()), tricks(n);
+    parallel_for(n, num_threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) tricks[i] = next[i] == none ? 0 : 1;
+    });
+    std::vector<int64_t> next2(n), remaining2(n), tricks2(n);
+    for (size_t span = 1; span < 2 * n; span *= 2) {
+        parallel_for(n, num_threads, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                int64_t j = next[i];
+                if (j == none) {
+                    next2[i] = none;
+                    remaining2[i] = remaining[i];
+                    tricks2[i] = tricks[i];
+                } else {
+                    next2[i] = next[j];
+                    remaining2[i] = remaining[i] + remaining[j];
+                    tricks2[i] = tricks[i] + tricks[j];
+                }
+            }
+        });
+        next.swap(next2);
+        remaining.swap(remaining2);
+        tricks.swap(tricks2);
+    }
+
+    size_t finishing = 0, hubs = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (next[i] == none) finishing++;
+        if (in_degree[i].load() >= 2) hubs++;
+    }
+    std::cout << n << " nodes, " << finishing << " reach the end of the game, "
+              << (n - finishing) << " lead into cycles, " << hubs << " hubs (in-degree >= 2)" << std::endl;
+
+    // Hubs with the longest tails, i.e. where many deals funnel into a long ending
+    std::vector<size_t> order;
+    for (size_t i = 0; i < n; ++i) {
+        if (next[i] == none && in_degree[i].load() >= 2) order.push_back(i);
+    }
+    size_t shown = std::min(order.size(), size_t(top));
+    std::partial_sort(order.begin(), order.begin() + shown, order.end(), [&](size_t a, size_t b) {
+        return remaining[a] > remaining[b];
+    });
+    std::cout << "\nfingerprint,in_degree,remaining_cards,remaining_tricks,origin_deal" << std::endl;
+    for (size_t k = 0; k < shown; ++k) {
+        size_t i = order[k];
+        std::cout << std::hex << fps[i] << std::dec << "," << in_degree[i].load() << ","
+                  << remaining[i] << "," << tricks[i] << "," << make_deal(seed, origin[i]) << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    build_options opt;
+    opt.num_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string load;
+    int top = 20;
+
+    // Parse command line arguments: [num_games] [num_threads] [options]
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--out" && has_value) {
+            opt.out = argv[++i];
+        } else if (arg == "--load" && has_value) {
+            load = argv[++i];
+        } else if (arg == "--seed" && has_value) {
+            opt.seed = std::stoull(argv[++i]);
+        } else if (arg == "--table-mb" && has_value) {
+            opt.table_bytes = std::stoull(argv[++i]) << 20;
+        } else if (arg == "--run-edges" && has_value) {
+            opt.run_edges = std::stoull(argv[++i]);
+        } else if (arg == "--top" && has_value) {
+            top = std::stoi(argv[++i]);
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cout << "Usage: " << argv[0] << " [num_games] [num_threads] [--out FILE] [--seed N]"
+                      << " [--table-mb N] [--run-edges N] [--top N]" << std::endl;
+            std::cout << "       " << argv[0] << " --load FILE [num_threads] [--seed N] [--top N]" << std::endl;
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (!load.empty()) {
+        if (positional.size() > 0) opt.num_threads = std::stoi(positional[0]);
+    } else {
+        if (positional.size() > 0) opt.num_games = std::stol(positional[0]);
+        if (positional.size() > 1) opt.num_threads = std::stoi(positional[1]);
+    }
+
+    try {
+        if (load.empty()) {
+            std::cout << "Building state graph from " << opt.num_games << " games with "
+                      << opt.num_threads << " threads" << std::endl;
+            build(opt);
+            load = opt.out;
+        }
+        analyse(load, opt.num_threads, opt.seed, top);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
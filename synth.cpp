@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Synthesises deals that reproduce a given opening: a sequence of trick winners
+// and, optionally, the pile size of each trick. The game is played with the
+// rules from main-imp.cpp on a deck whose positions are only assigned a card at
+// the moment a player reads them, branching over the card types still left.
+// Every trick checks the constraints, so inconsistent branches die as soon as
+// they diverge. Positions that were never read stay open ('?') in the output;
+// each printed deal stands for all ways of filling them.
+
+constexpr int deck_size = 52;
+constexpr int half = deck_size / 2;
+constexpr int copies[5] = {36, 4, 4, 4, 4}; // non-face cards, J, Q, K, A
+
+struct constraints {
+    std::vector<int> winners; // 1 or 2 per trick, empty if unconstrained
+    std::vector<int> sizes;   // pile size per trick, empty if unconstrained
+    int tricks = 0;
+    int start_player = 1;
+};
+
+// Game state over a partially assigned deck. Hands and pile hold deck positions.
+struct partial_game {
+    int8_t card[deck_size];
+    int8_t left[5];
+    uint8_t hand[2][deck_size];
+    uint8_t head[2] = {0, 0};
+    uint8_t count[2] = {half, half};
+    uint8_t pile[deck_size];
+    uint8_t pile_size = 0;
+    uint8_t active = 0;
+    uint8_t remaining_penalties = 0;
+    bool face_card_active = false;
+    int trick = 0;
+
+    explicit partial_game(int start_player) {
+        std::fill(card, card + deck_size, -1);
+        std::copy(copies, copies + 5, left);
+        for (int i = 0; i < half; ++i) {
+            hand[0][i] = uint8_t(i);
+            hand[1][i] = uint8_t(half + i);
+        }
+        active = uint8_t(start_player == 2);
+    }
+
+    int front() const {
+        return hand[active][head[active]];
+    }
+
+    void assign(int pos, int value) {
+        card[pos] = int8_t(value);
+        left[value]--;
+    }
+
+    // Play one card (which must be assigned). Returns true if it completed a trick.
+    bool turn() {
+        int pos = front();
+        head[active] = uint8_t((head[active] + 1) % deck_size);
+        count[active]--;
+        pile[pile_size++] = uint8_t(pos);
+        int c = card[pos];
+        if (c > 0) {
+            face_card_active = true;
+            remaining_penalties = uint8_t(c);
+            active ^= 1;
+        } else if (face_card_active) {
+            if (--remaining_penalties == 0) {
+                face_card_active = false;
+                return true;
+            }
+            active ^= 1;
+        } else {
+            active ^= 1;
+        }
+        return false;
+    }
+
+    // The trick winner (the active player) picks up the pile
+    void pick_up() {
+        for (int i = 0; i < pile_size; ++i) {
+            hand[active][(head[active] + count[active]) % deck_size] = pile[i];
+            count[active]++;
+        }
+        pile_size = 0;
+        trick++;
+    }
+
+    std::string pattern() const {
+        static const char names[] = "-JQKA";
+        std::string s(deck_size, '?');
+        for (int i = 0; i < deck_size; ++i) {
+            if (card[i] >= 0) s[i] = names[int(card[i])];
+        }
+        return s;
+    }
+
+    // Number of complete deals that match the pattern
+    long double completions() const {
+        int open = 0;
+        for (int v = 0; v < 5; ++v) open += left[v];
+        long double log_ways = std::lgamma((long double)(open + 1));
+        for (int v = 0; v < 5; ++v) log_ways -= std::lgamma((long double)(left[v] + 1));
+        return std::exp(log_ways);
+    }
+};
+
+enum class outcome { branch, done, fail };
+
+// Play forward until a still unassigned position has to be read, the opening is
+// complete, or a constraint is violated
+outcome advance(partial_game& g, const constraints& c) {
+    while (true) {
+        if (g.trick == c.tricks) return outcome::done;
+        if (g.count[0] == 0 || g.count[1] == 0) return outcome::fail;
+        if (g.card[g.front()] < 0) return outcome::branch;
+        if (g.turn()) {
+            if (!c.winners.empty() && g.active + 1 != c.winners[g.trick]) return outcome::fail;
+            if (!c.sizes.empty() && g.pile_size != c.sizes[g.trick]) return outcome::fail;
+            g.pick_up();
+        } else if (!c.sizes.empty() && g.pile_size >= c.sizes[g.trick]) {
+            // The pile can only grow until the trick is picked up
+            return outcome::fail;
+        }
+    }
+}
+
+// Read the opening of a known deal to use as constraints
+constraints trace_opening(const std::string& deal, int tricks, int start_player) {
+    partial_game g(start_player);
+    for (int i = 0; i < deck_size; ++i) {
+        int v = 0;
+        switch (i < int(deal.size()) ? deal[i] : '-') {
+            case 'J': v = 1; break;
+            case 'Q': v = 2; break;
+            case 'K': v = 3; break;
+            case 'A': v = 4; break;
+        }
+        g.assign(i, v);
+    }
+    constraints c;
+    c.start_player = start_player;
+    while (int(c.winners.size()) < tricks && g.count[0] > 0 && g.count[1] > 0) {
+        if (g.turn()) {
+            c.winners.push_back(g.active + 1);
+            c.sizes.push_back(g.pile_size);
+            g.pick_up();
+        }
+    }
+    c.tricks = int(c.winners.size());
+    return c;
+}
+
+class synthesiser {
+private:
+    const constraints& c;
+    long limit;
+    std::mutex output_mutex;
+    std::atomic<long> found{0};
+    std::atomic<bool> stop{false};
+    long double total_deals = 0;
+
+    void emit(const partial_game& g) {
+        long n = ++found;
+        if (limit > 0 && n > limit) {
+            stop = true;
+            return;
+        }
+        std::lock_guard<std::mutex> lock(output_mutex);
+        long double ways = g.completions();
+        total_deals += ways;
+        std::cout << g.pattern() << "," << double(ways) << "\n";
+    }
+
+    // Whether reading `v` at the front can still satisfy the current trick: a face
+    // card needs room for its penalty in the trick's pile size, a non-face card
+    // that ends the trick must leave the pile at exactly that size with the
+    // right winner, and one that does not end it must leave room for the rest
+    bool feasible(const partial_game& g, int v) const {
+        bool completes = v == 0 && g.face_card_active && g.remaining_penalties == 1;
+        if (completes && !c.winners.empty() && g.active + 1 != c.winners[g.trick]) return false;
+        if (c.sizes.empty()) return true;
+        int need = c.sizes[g.trick] - g.pile_size; // cards of this trick still to come, this one included
+        if (v > 0) return need - 1 >= v;
+        if (completes) return need == 1;
+        if (g.face_card_active) return need >= g.remaining_penalties;
+        return need >= 3;
+    }
+
+    // Every card that the front position can hold
+    void expand(const partial_game& g, std::vector<partial_game>& out) {
+        int pos = g.front();
+        for (int v = 0; v < 5; ++v) {
+            if (g.left[v] == 0 || !feasible(g, v)) continue;
+            out.push_back(g);
+            out.back().assign(pos, v);
+        }
+    }
+
+    void search(partial_game g) {
+        if (stop) return;
+        switch (advance(g, c)) {
+            case outcome::done: emit(g); return;
+            case outcome::fail: return;
+            case outcome::branch: break;
+        }
+        std::vector<partial_game> children;
+        expand(g, children);
+        for (auto& child : children) search(child);
+    }
+
+public:
+    synthesiser(const constraints& c, long limit) : c(c), limit(limit) {}
+
+    void run(int num_threads) {
+        // Split the search tree breadth-first until every thread has plenty of subtrees
+        std::vector<partial_game> frontier{partial_game(c.start_player)};
+        while (!frontier.empty() && frontier.size() < size_t(64 * num_threads)) {
+            std::vector<partial_game> next;
+            for (auto& g : frontier) {
+                switch (advance(g, c)) {
+                    case outcome::done: emit(g); break;
+                    case outcome::fail: break;
+                    case outcome::branch: expand(g, next); break;
+                }
+            }
+            frontier.swap(next);
+        }
+
+        std::atomic<size_t> next_subtree{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&] {
+                for (size_t i; (i = next_subtree.fetch_add(1)) < frontier.size() && !stop;) {
+                    search(frontier[i]);
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+    }
+
+    long solutions() const {
+        return limit > 0 ? std::min(found.load(), limit) : found.load();
+    }
+
+    bool truncated() const { return stop; }
+    long double deals() const { return total_deals; }
+};
+
+std::vector<int> parse_list(const std::string& s) {
+    std::vector<int> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) out.push_back(std::stoi(item));
+    return out;
+}
+
+int main(int argc, char* argv[]) {
+    constraints c;
+    std::string from;
+    int from_tricks = 30;
+    long limit = 100;
+    int num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--winners" && has_value) {
+            std::string w = argv[++i];
+            for (char ch : w) {
+                if (ch == '1' || ch == '2') c.winners.push_back(ch - '0');
+            }
+        } else if (arg == "--sizes" && has_value) {
+            c.sizes = parse_list(argv[++i]);
+        } else if (arg == "--from" && has_value) {
+            from = argv[++i];
+        } else if (arg == "--tricks" && has_value) {
+            from_tricks = std::stoi(argv[++i]);
+        } else if (arg == "--start" && has_value) {
+            c.start_player = std::stoi(argv[++i]) == 2 ? 2 : 1;
+        } else if (arg == "--limit" && has_value) {
+            limit = std::stol(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            num_threads = std::max(1, std::stoi(argv[++i]));
+        }
+    }
+
+    if (!from.empty()) {
+        c = trace_opening(from, from_tricks, c.start_player);
+    } else {
+        if (!c.winners.empty() && !c.sizes.empty() && c.winners.size() != c.sizes.size()) {
+            std::cerr << "Error: --winners and --sizes describe a different number of tricks" << std::endl;
+            return 1;
+        }
+        c.tricks = int(std::max(c.winners.size(), c.sizes.size()));
+    }
+    if (c.tricks == 0) {
+        std::cout << "Usage: " << argv[0] << " --winners 1221... [--sizes 3,5,...] [options]" << std::endl;
+        std::cout << "       " << argv[0] << " --from <deck-string> [--tricks N] [options]" << std::endl;
+        std::cout << "Options: --start 1|2  --limit N (0 = all)  --threads N" << std::endl;
+        std::cout << "Prints one line per consistent deal, '?' marking positions the opening never reads," << std::endl;
+        std::cout << "followed by the number of complete deals it stands for" << std::endl;
+        return 1;
+    }
+
+    std::cerr << "Synthesising deals for " << c.tricks << " tricks";
+    if (!c.winners.empty()) {
+        std::cerr << ", winners ";
+        for (int w : c.winners) std::cerr << w;
+    }
+    std::cerr << std::endl;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    synthesiser s(c, limit);
+    s.run(num_threads);
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    std::cerr << s.solutions() << " consistent deals" << (s.truncated() ? " (limit reached)" : "")
+              << " standing for " << double(s.deals()) << " complete deals, in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms" << std::endl;
+    return 0;
+}
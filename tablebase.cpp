@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Generates endgame tablebases for the rules in main-imp.cpp.
+//
+// A position is a trick boundary (empty pile, no penalty running) where one
+// player, the small hand, holds at most k cards and the other holds more than m.
+// From there the game is played out knowing only the small hand and the first m
+// cards of the big hand. The big hand's later cards, and anything it picks up,
+// sit behind the unknown part. So if the game ends before the big hand has to
+// play its (m+1)-th card, the result holds for every position with that small
+// hand and prefix. Such entries store the remaining cards and tricks; the
+// winner is always the big hand, which cannot run out inside the window.
+// Entries where the window runs out stay 0.
+//
+// The file is a header followed by one uint32 per position, so it can be
+// memory-mapped and probed directly. Generation runs in chunks on all threads.
+// Finished chunks are flagged in the header, so an interrupted run continues
+// where it stopped.
+
+constexpr char tablebase_magic[8] = {'B', 'M', 'N', 'T', 'B', '1', 0, 0};
+constexpr uint64_t chunk_entries = 1 << 16;
+constexpr uint64_t data_offset = 1 << 16; // header and chunk flags live before this
+
+struct tablebase_header {
+    char magic[8];
+    uint32_t max_small; // k
+    uint32_t window;    // m
+    uint64_t entries;
+    uint64_t chunks;
+};
+
+// Entry layout: bit 31 resolved, bits 16..23 tricks, bits 0..15 remaining cards
+constexpr uint32_t resolved_bit = 1u << 31;
+
+uint64_t power5(int n) {
+    uint64_t p = 1;
+    while (n-- > 0) p *= 5;
+    return p;
+}
+
+// Positions are numbered by small hand length, small hand cards (base 5),
+// big hand prefix (base 5), and which side moves first
+uint64_t entry_count(int k, int m) {
+    uint64_t hands = 0;
+    for (int s = 1; s <= k; ++s) hands += power5(s);
+    return hands * power5(m) * 2;
+}
+
+// Play the window for one position. Hands hold cards 0..4; the big hand ends in
+// an unknown part, marked by playing past the end of `big`.
+uint32_t solve(std::vector<int> small, std::vector<int> big, bool small_moves) {
+    std::vector<int> hands[2] = {std::move(small), std::move(big)};
+    size_t head[2] = {0, 0};
+    std::vector<int> pile;
+    int active = small_moves ? 0 : 1;
+    int remaining_penalties = 0;
+    bool face_card_active = false;
+    uint32_t moves = 0, tricks = 0;
+    // Cards the big hand picks up go behind its unknown part
+    while (head[0] < hands[0].size()) {
+        if (active == 1 && head[1] == hands[1].size()) {
+            return 0;
+        }
+        int card = hands[active][head[active]++];
+        pile.push_back(card);
+        moves++;
+        if (card > 0) {
+            face_card_active = true;
+            remaining_penalties = card;
+            active ^= 1;
+        } else if (face_card_active) {
+            if (--remaining_penalties == 0) {
+                tricks++;
+                face_card_active = false;
+                if (active == 0) {
+                    hands[0].insert(hands[0].end(), pile.begin(), pile.end());
+                }
+                pile.clear();
+            } else {
+                active ^= 1;
+            }
+        } else {
+            active ^= 1;
+        }
+    }
+    if (moves > 0xffff || tricks > 0xff) {
+        return 0;
+    }
+    // The small hand ran out, so the big hand wins
+    return resolved_bit | (tricks << 16) | moves;
+}
+
+// Inverse of the position numbering
+void decode(uint64_t index, int k, int m, std::vector<int>& small, std::vector<int>& big, bool& small_moves) {
+    small_moves = (index & 1) == 0;
+    index >>= 1;
+    uint64_t prefixes = power5(m);
+    uint64_t big_code = index % prefixes;
+    uint64_t small_code = index / prefixes;
+    int s = 1;
+    while (s < k && small_code >= power5(s)) {
+        small_code -= power5(s);
+        s++;
+    }
+    small.resize(s);
+    for (int i = s - 1; i >= 0; --i) {
+        small[i] = int(small_code % 5);
+        small_code /= 5;
+    }
+    big.resize(m);
+    for (int i = m - 1; i >= 0; --i) {
+        big[i] = int(big_code % 5);
+        big_code /= 5;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string file_name = "tablebase.bin";
+    int k = 3, m = 6;
+    int num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Parse command line arguments: [file] [--small k] [--window m] [--threads N]
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--small" && has_value) {
+            k = std::stoi(argv[++i]);
+        } else if (arg == "--window" && has_value) {
+            m = std::stoi(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            num_threads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cout << "Usage: " << argv[0] << " [file] [--small k] [--window m] [--threads N]" << std::endl;
+            return 1;
+        } else {
+            file_name = arg;
+        }
+    }
+    if (k < 1 || m < 1 || k + m > 26) {
+        std::cerr << "Error: need 1 <= k, 1 <= m and k + m <= 26" << std::endl;
+        return 1;
+    }
+
+    tablebase_header header{};
+    std::memcpy(header.magic, tablebase_magic, sizeof(header.magic));
+    header.max_small = uint32_t(k);
+    header.window = uint32_t(m);
+    header.entries = entry_count(k, m);
+    header.chunks = (header.entries + chunk_entries - 1) / chunk_entries;
+    if (sizeof(header) + header.chunks > data_offset) {
+        std::cerr << "Error: table too large (" << header.entries << " entries)" << std::endl;
+        return 1;
+    }
+
+    int fd = open(file_name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Error opening file '" << file_name << "'" << std::endl;
+        return 1;
+    }
+
+    // Resume a run with the same parameters, otherwise start a new file
+    std::vector<uint8_t> done(header.chunks, 0);
+    tablebase_header existing{};
+    bool resume = pread(fd, &existing, sizeof(existing), 0) == ssize_t(sizeof(existing)) &&
+                  std::memcmp(&existing, &header, sizeof(header)) == 0 &&
+                  pread(fd, done.data(), done.size(), sizeof(header)) == ssize_t(done.size());
+    if (!resume) {
+        std::fill(done.begin(), done.end(), 0);
+        if (ftruncate(fd, 0) != 0 ||
+            ftruncate(fd, off_t(data_offset + header.entries * sizeof(uint32_t))) != 0 ||
+            pwrite(fd, &header, sizeof(header), 0) != ssize_t(sizeof(header)) ||
+            pwrite(fd, done.data(), done.size(), sizeof(header)) != ssize_t(done.size())) {
+            std::cerr << "Error initialising '" << file_name << "'" << std::endl;
+            return 1;
+        }
+    }
+    size_t already = std::count(done.begin(), done.end(), 1);
+    std::cout << "Tablebase k=" << k << " m=" << m << ": " << header.entries << " positions in "
+              << header.chunks << " chunks, " << already << " already done" << std::endl;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    std::atomic<uint64_t> next_chunk{0}, resolved{0}, finished{0};
+    std::atomic<bool> failed{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&] {
+            std::vector<uint32_t> entries(chunk_entries);
+            std::vector<int> small, big;
+            bool small_moves;
+            for (uint64_t c; (c = next_chunk.fetch_add(1)) < header.chunks && !failed;) {
+                if (done[c]) continue;
+                uint64_t begin = c * chunk_entries;
+                uint64_t end = std::min(header.entries, begin + chunk_entries);
+                for (uint64_t i = begin; i < end; ++i) {
+                    decode(i, k, m, small, big, small_moves);
+                    uint32_t e = solve(small, big, small_moves);
+                    entries[i - begin] = e;
+                    if (e) resolved++;
+                }
+                // Entries first, then the flag, so a flagged chunk is always complete
+                size_t bytes = (end - begin) * sizeof(uint32_t);
+                uint8_t one = 1;
+                if (pwrite(fd, entries.data(), bytes, off_t(data_offset + begin * sizeof(uint32_t))) != ssize_t(bytes) ||
+                    fdatasync(fd) != 0 ||
+                    pwrite(fd, &one, 1, off_t(sizeof(header) + c)) != 1) {
+                    failed = true;
+                }
+                finished++;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    close(fd);
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    if (failed) {
+        std::cerr << "Error writing '" << file_name << "'; run again to resume" << std::endl;
+        return 1;
+    }
+    std::cout << "Solved " << finished << " chunks in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms, "
+              << resolved << " positions resolved in this run" << std::endl;
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -12,6 +13,10 @@
 #include <functional>
 #include <unordered_set>
 #include <string>
+#include <cctype>
+#include <numeric>
+#include <pthread.h>
+#include <sched.h>
 
 // Card representation: 0=non-face card, 1=J, 2=Q, 3=K, 4=A
 struct deck {
@@ -96,12 +101,9 @@ struct player {
 
 // Game state hash for cycle detection
 struct GameStateHash {
-    std::size_t operator()(const std::pair<std::vector<int>, std::vector<int>>& state) const {
-        std::size_t seed = state.first.size();
-        for (auto& i : state.first) {
-            seed ^= i + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-        }
-        for (auto& i : state.second) {
+    std::size_t operator()(const std::vector<int>& state) const {
+        std::size_t seed = state.size();
+        for (auto& i : state) {
             seed ^= i + 0x9e3779b9 + (seed << 6) + (seed >> 2);
         }
         return seed;
@@ -123,16 +125,19 @@ private:
     player* active_player;
     int max_moves;
     bool verbose;
+    bool detect_cycles;
     
     // For cycle detection
-    std::unordered_set<std::pair<std::vector<int>, std::vector<int>>, GameStateHash> seen_states;
+    std::unordered_set<std::vector<int>, GameStateHash> seen_states;
 
 public:
-    game(const deck& initial_deck, int move_limit = 100000, bool verbose_output = false) 
+    game(const deck& initial_deck, int move_limit = 100000, bool verbose_output = false,
+         bool cycle_detection = true) 
         : d(initial_deck), p1(1), p2(2), 
           rng(std::random_device{}()), 
           max_moves(move_limit),
-          verbose(verbose_output) {}
+          verbose(verbose_output),
+          detect_cycles(cycle_detection) {}
 
     void start() {
         split_cards();
@@ -182,14 +187,16 @@ public:
         bool cycled = false;
         
         while (!is_game_over() && cards_played_total < max_moves) {
-            // Check for cycles (same cards in same order for both players)
-            auto state = std::make_pair(p1.cards, p2.cards);
-            if (seen_states.count(state) > 0) {
-                // We've seen this exact state before - it's a cycle
-                cycled = true;
-                break;
+            // Check for cycles (same hands, pile, player to move and penalty)
+            if (detect_cycles) {
+                auto state = current_state();
+                if (seen_states.count(state) > 0) {
+                    // We've seen this exact state before - it's a cycle
+                    cycled = true;
+                    break;
+                }
+                seen_states.insert(std::move(state));
             }
-            seen_states.insert(state);
             
             turn();
             
@@ -218,6 +225,21 @@ public:
         return p1.cards.empty() || p2.cards.empty();
     }
 
+    // Hands, pile, player to move and penalty: the hands alone can repeat
+    // in a game that still ends
+    std::vector<int> current_state() const {
+        std::vector<int> state;
+        state.reserve(p1.cards.size() + p2.cards.size() + pile.size() + 4);
+        state.insert(state.end(), p1.cards.begin(), p1.cards.end());
+        state.push_back(-1);
+        state.insert(state.end(), p2.cards.begin(), p2.cards.end());
+        state.push_back(-1);
+        state.insert(state.end(), pile.begin(), pile.end());
+        state.push_back(-active_player->id - 1);
+        state.push_back(remaining_penalties);
+        return state;
+    }
+
     void turn() {
         if (active_player->cards.empty()) {
             return;
@@ -286,21 +308,73 @@ public:
     }
 };
 
+// Replay the deck `runs` times after `warmup` untimed runs and report the
+// distribution of single-game latencies
+int run_bench(const deck& test_deck, int runs, int warmup, bool detect_cycles) {
+    std::vector<long long> samples;
+    samples.reserve(runs);
+    int moves = 0;
+    for (int i = -warmup; i < runs; ++i) {
+        game g(test_deck, 1000000, false, detect_cycles);
+        g.start();
+        
+        auto start_time = std::chrono::steady_clock::now();
+        auto result = g.play();
+        auto end_time = std::chrono::steady_clock::now();
+        
+        moves = std::get<1>(result);
+        if (i >= 0) {
+            samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count());
+        }
+    }
+    
+    std::sort(samples.begin(), samples.end());
+    long long min_ns = samples.front();
+    long long median_ns = samples[samples.size() / 2];
+    long long p99_ns = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    double mean_ns = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    
+    std::cout << "\nBenchmark (" << runs << " runs, " << warmup << " warm-up, cycle detection "
+              << (detect_cycles ? "on" : "off") << "):" << std::endl;
+    std::cout << "------------" << std::endl;
+    std::cout << "Moves per game: " << moves << std::endl;
+    std::cout << "min:    " << min_ns << " ns (" << double(min_ns) / moves << " ns/move)" << std::endl;
+    std::cout << "median: " << median_ns << " ns (" << double(median_ns) / moves << " ns/move)" << std::endl;
+    std::cout << "p99:    " << p99_ns << " ns (" << double(p99_ns) / moves << " ns/move)" << std::endl;
+    std::cout << "mean:   " << mean_ns << " ns (" << mean_ns / moves << " ns/move)" << std::endl;
+    
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cout << "Usage: " << argv[0] << " <deck-string> [--verbose]" << std::endl;
+        std::cout << "Usage: " << argv[0] << " <deck-string> [--verbose] [--bench [runs]] [--pin cpu] [--no-cycle-check]" << std::endl;
         std::cout << "Example: " << argv[0] << " \"J--K---A--Q--J---A-K--Q-J--A--K-Q-J---A--Q--K--\"" << std::endl;
         std::cout << "Use '-' for non-face cards and J,Q,K,A for face cards" << std::endl;
+        std::cout << "--bench replays the deck repeatedly and reports latency in nanoseconds" << std::endl;
         return 1;
     }
     
     std::string deck_str = argv[1];
     bool verbose = false;
+    bool bench = false;
+    int bench_runs = 1000;
+    int pin_cpu = -1;
+    bool detect_cycles = true;
     
     for (int i = 2; i < argc; i++) {
         std::string arg = argv[i];
         if (arg == "--verbose" || arg == "-v") {
             verbose = true;
+        } else if (arg == "--bench") {
+            bench = true;
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                bench_runs = std::max(1, std::stoi(argv[++i]));
+            }
+        } else if (arg == "--pin" && i + 1 < argc) {
+            pin_cpu = std::stoi(argv[++i]);
+        } else if (arg == "--no-cycle-check") {
+            detect_cycles = false;
         }
     }
     
@@ -314,10 +388,23 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    if (pin_cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(pin_cpu, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            std::cerr << "Warning: could not pin to CPU " << pin_cpu << std::endl;
+        }
+    }
+    
     std::cout << "Testing deck: " << test_deck << std::endl;
     
+    if (bench) {
+        return run_bench(test_deck, bench_runs, std::max(1, bench_runs / 10), detect_cycles);
+    }
+    
     // Create a game with the specified deck
-    game g(test_deck, 1000000, verbose);
+    game g(test_deck, 1000000, verbose, detect_cycles);
     g.start();
     
     auto start_time = std::chrono::high_resolution_clock::now();